@@ -0,0 +1,341 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+// Drives WallTracking with a loopback LaserScan publisher and measures the
+// scan -> cmd_vel latency, its jitter and the process CPU usage for each
+// executor type. Each cmd_vel is paired with the scan the node last processed
+// (by header stamp), so scans the node skipped do not shift the pairing.
+// Output is CSV on stdout.
+//
+// With --perf, hardware counters (perf_event_open) of the executor threads are
+// added per scan. They include the loopback node that runs on the same
+// executor; columns stay empty when the counters are unavailable.
+//
+// usage: executor_benchmark [--executors a,b,..] [--rates 10,40] [--beams 360,1440]
+//                           [--duration sec] [--threads n] [--intra-process] [--perf]
+
+#include "wall_tracking_executor/wall_tracking_executor.hpp"
+#include "wall_tracking_executor/ExecutorFactory.hpp"
+#include "wall_tracking_executor/PerfCounters.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+using namespace std::chrono_literals;
+using SteadyTime = std::chrono::steady_clock::time_point;
+
+namespace {
+struct BenchConfig {
+    std::vector<std::string> executors = WallTracking::availableExecutorTypes();
+    std::vector<double> rates{10., 40.};
+    std::vector<int> beams{360, 1440};
+    double duration = 5.;
+    std::size_t threads = 0;
+    bool intra_process = false;
+    bool perf = false;
+};
+
+struct BenchResult {
+    std::size_t samples = 0, scans = 0;
+    double latency_mean = 0., latency_p50 = 0., latency_p99 = 0., latency_max = 0.;
+    double jitter = 0.;
+};
+
+template<typename T>
+std::vector<T> splitList(const std::string &arg)
+{
+    std::vector<T> out;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        std::stringstream is(item);
+        T v;
+        is >> v;
+        out.push_back(v);
+    }
+    return out;
+}
+
+BenchConfig parseArgs(const std::vector<std::string> &args)
+{
+    BenchConfig config;
+    for (std::size_t i = 1; i < args.size(); ++i) {
+        const std::string &a = args[i];
+        bool has_value = i + 1 < args.size();
+        if (a == "--executors" && has_value) config.executors = splitList<std::string>(args[++i]);
+        else if (a == "--rates" && has_value) config.rates = splitList<double>(args[++i]);
+        else if (a == "--beams" && has_value) config.beams = splitList<int>(args[++i]);
+        else if (a == "--duration" && has_value) config.duration = std::stod(args[++i]);
+        else if (a == "--threads" && has_value) config.threads = std::stoul(args[++i]);
+        else if (a == "--intra-process") config.intra_process = true;
+        else if (a == "--perf") config.perf = true;
+        else std::cerr << "ignoring unknown argument: " << a << std::endl;
+    }
+    return config;
+}
+
+void printPerScan(std::int64_t value, std::size_t scans)
+{
+    if (value < 0 || scans == 0) std::printf(",");
+    else std::printf(",%.0f", static_cast<double>(value) / static_cast<double>(scans));
+}
+
+double cpuSeconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+// 左0.8[m]に壁、右3[m]に壁がある直線通路を模したスキャン
+sensor_msgs::msg::LaserScan corridorScan(int beams, double rate)
+{
+    sensor_msgs::msg::LaserScan msg;
+    msg.header.frame_id = "base_scan";
+    msg.angle_increment = 2 * M_PI / beams;
+    msg.angle_min = -M_PI;
+    msg.angle_max = M_PI - msg.angle_increment;
+    msg.scan_time = 1. / rate;
+    msg.time_increment = msg.scan_time / beams;
+    msg.range_min = 0.12;
+    msg.range_max = 12.;
+    msg.ranges.resize(beams);
+    for (int i = 0; i < beams; ++i) {
+        double a = msg.angle_min + i * msg.angle_increment;
+        double s = std::sin(a);
+        double r = s > 0. ? 0.8 / s : -3. / s;
+        msg.ranges[i] = std::isfinite(r) ? std::min<double>(r, msg.range_max) : msg.range_max;
+    }
+    return msg;
+}
+
+class ScanLoopback : public rclcpp::Node
+{
+public:
+    ScanLoopback(double rate, int beams, std::shared_ptr<const WallTracking::WallTracking> wall_tracking,
+        const rclcpp::NodeOptions &options)
+    : Node("scan_loopback", options), scan_msg_(corridorScan(beams, rate)), wall_tracking_(std::move(wall_tracking))
+    {
+        scan_pub_ = this->create_publisher<sensor_msgs::msg::LaserScan>("scan", rclcpp::QoS(10));
+        goal_pose_pub_ = this->create_publisher<geometry_msgs::msg::PoseStamped>("goal_pose", rclcpp::QoS(1));
+        cmd_vel_sub_ = this->create_subscription<geometry_msgs::msg::Twist>(
+            "cmd_vel", rclcpp::QoS(10),
+            std::bind(&ScanLoopback::cmdVelCallback, this, std::placeholders::_1));
+        action_client_ = rclcpp_action::create_client<WallTrackingAction>(this, "wall_tracking");
+        timer_ = this->create_wall_timer(
+            std::chrono::duration<double>(1. / rate),
+            std::bind(&ScanLoopback::timerCallback, this));
+    }
+
+    bool startTracking()
+    {
+        if (!action_client_->wait_for_action_server(5s)) return false;
+        geometry_msgs::msg::PoseStamped goal_pose;
+        goal_pose.header.frame_id = "map";
+        goal_pose_pub_->publish(goal_pose);
+        WallTrackingAction::Goal goal;
+        goal.start = true;
+        auto future = action_client_->async_send_goal(goal);
+        if (future.wait_for(5s) != std::future_status::ready) return false;
+        goal_handle_ = future.get();
+        return goal_handle_ != nullptr;
+    }
+
+    void stopTracking()
+    {
+        if (goal_handle_) action_client_->async_cancel_goal(goal_handle_);
+    }
+
+    void beginMeasure()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        latencies_.clear();
+        arrivals_.clear();
+        pending_.clear();
+        scans_ = 0;
+        measuring_ = true;
+    }
+
+    BenchResult endMeasure()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        measuring_ = false;
+        BenchResult res;
+        res.scans = scans_;
+        res.samples = latencies_.size();
+        if (latencies_.empty()) return res;
+        std::vector<double> sorted = latencies_;
+        std::sort(sorted.begin(), sorted.end());
+        res.latency_mean = std::accumulate(sorted.begin(), sorted.end(), 0.) / sorted.size();
+        res.latency_p50 = sorted[sorted.size() / 2];
+        res.latency_p99 = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+        res.latency_max = sorted.back();
+        // cmd_velの到着間隔の標準偏差をジッタとする
+        if (arrivals_.size() > 2) {
+            std::vector<double> intervals;
+            for (std::size_t i = 1; i < arrivals_.size(); ++i) {
+                intervals.push_back(std::chrono::duration<double>(arrivals_[i] - arrivals_[i - 1]).count());
+            }
+            double mean = std::accumulate(intervals.begin(), intervals.end(), 0.) / intervals.size();
+            double var = 0.;
+            for (double v : intervals) var += (v - mean) * (v - mean);
+            res.jitter = std::sqrt(var / intervals.size());
+        }
+        return res;
+    }
+
+private:
+    void timerCallback()
+    {
+        scan_msg_.header.stamp = this->now();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (measuring_) {
+                pending_.emplace_back(rclcpp::Time(scan_msg_.header.stamp).nanoseconds(),
+                    std::chrono::steady_clock::now());
+                ++scans_;
+            }
+        }
+        scan_pub_->publish(scan_msg_);
+    }
+
+    void cmdVelCallback([[maybe_unused]] geometry_msgs::msg::Twist::ConstSharedPtr msg)
+    {
+        auto now = std::chrono::steady_clock::now();
+        // ノードが最後に処理したスキャンの時刻で、どのスキャンからの指令かを決める
+        std::int64_t stamp_ns = wall_tracking_->latestScanFeatures().stamp_ns;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!measuring_) return;
+        // 読み飛ばされたスキャンは指令を出さないので捨てる
+        while (!pending_.empty() && pending_.front().first < stamp_ns) pending_.pop_front();
+        // 同じスキャンからの2つめ以降の指令(旋回など)は数えない
+        if (pending_.empty() || pending_.front().first != stamp_ns) return;
+        latencies_.push_back(std::chrono::duration<double>(now - pending_.front().second).count());
+        pending_.pop_front();
+        arrivals_.push_back(now);
+    }
+
+    sensor_msgs::msg::LaserScan scan_msg_;
+    rclcpp::Publisher<sensor_msgs::msg::LaserScan>::SharedPtr scan_pub_;
+    rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr goal_pose_pub_;
+    rclcpp::Subscription<geometry_msgs::msg::Twist>::SharedPtr cmd_vel_sub_;
+    rclcpp_action::Client<WallTrackingAction>::SharedPtr action_client_;
+    rclcpp_action::ClientGoalHandle<WallTrackingAction>::SharedPtr goal_handle_;
+    rclcpp::TimerBase::SharedPtr timer_;
+
+    std::mutex mutex_;
+    bool measuring_ = false;
+    std::size_t scans_ = 0;
+    std::shared_ptr<const WallTracking::WallTracking> wall_tracking_;
+    std::deque<std::pair<std::int64_t, SteadyTime>> pending_; //スキャンの時刻と公開した時刻
+    std::vector<SteadyTime> arrivals_;
+    std::vector<double> latencies_;
+};
+
+rclcpp::NodeOptions wallTrackingOptions(bool intra_process)
+{
+    // config/wall_tracking_executor.param.yamlと同じ値
+    return rclcpp::NodeOptions()
+        .use_intra_process_comms(intra_process)
+        .parameter_overrides({
+            {"distance_from_wall", 0.8}, {"distance_to_stop", 0.8},
+            {"max_linear_vel", 0.22}, {"max_angular_vel", 0.7}, {"min_angular_vel", -0.7},
+            {"sampling_rate", 0.033}, {"kp", 12.0}, {"ki", 0.0}, {"kd", 0.0},
+            {"start_deg_lateral", 69}, {"end_deg_lateral", 78}, {"stop_ray_th", 0.1},
+            {"wheel_separation", 0.28}, {"distance_to_skip", 0.6}, {"open_place_distance", 12.5},
+            {"detection_div_deg", std::vector<double>{-9., 9., 9., 27., -27., -9., 27., 45., -45., -27.}},
+            {"select_angvel", std::vector<double>{0., 0.2, -0.2, 0.35, -0.35}},
+            // navigate_to_poseサーバーがいないのでキャンセル待ちを短くする
+            {"nav_cancel_timeout", 0.1},
+        });
+}
+
+bool runCase(const BenchConfig &config, const std::string &type, double rate, int beams)
+{
+    rclcpp::Executor::SharedPtr executor;
+    try {
+        executor = WallTracking::createExecutor(type, config.threads);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << "skipping " << type << ": " << e.what() << std::endl;
+        return false;
+    }
+    auto wall_tracking = std::make_shared<WallTracking::WallTracking>(wallTrackingOptions(config.intra_process));
+    auto loopback = std::make_shared<ScanLoopback>(
+        rate, beams, wall_tracking, rclcpp::NodeOptions().use_intra_process_comms(config.intra_process));
+    wall_tracking->configure();
+    wall_tracking->activate();
+    executor->add_node(wall_tracking->get_node_base_interface());
+    executor->add_node(loopback);
+    // executorのスレッドを数えるため、スレッドを作る前に開いておく
+    WallTracking::PerfCounters counters;
+    std::string err;
+    if (config.perf && !counters.open(true, err)) {
+        std::cerr << "hardware counters unavailable: " << err << std::endl;
+    }
+    std::thread spin_thread([&executor]() { executor->spin(); });
+
+    bool ok = loopback->startTracking();
+    if (ok) {
+        // ゴール受付後のハンドオーバーを待ってから計測する
+        std::this_thread::sleep_for(500ms);
+        loopback->beginMeasure();
+        if (counters.available()) counters.start();
+        double cpu_start = cpuSeconds();
+        auto wall_start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::duration<double>(config.duration));
+        BenchResult res = loopback->endMeasure();
+        WallTracking::PerfSample perf = counters.available() ? counters.stop() : WallTracking::PerfSample();
+        double cpu = cpuSeconds() - cpu_start;
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+        std::printf("%s,%.1f,%d,%zu,%zu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f",
+            type.c_str(), rate, beams, res.scans, res.samples,
+            res.latency_mean * 1e6, res.latency_p50 * 1e6, res.latency_p99 * 1e6,
+            res.latency_max * 1e6, res.jitter * 1e6, 100. * cpu / wall);
+        printPerScan(perf.cycles, res.scans);
+        printPerScan(perf.instructions, res.scans);
+        printPerScan(perf.cache_misses, res.scans);
+        printPerScan(perf.branch_misses, res.scans);
+        std::printf("\n");
+        std::fflush(stdout);
+        loopback->stopTracking();
+        std::this_thread::sleep_for(300ms);
+    } else {
+        std::cerr << "failed to start wall tracking goal with " << type << std::endl;
+    }
+    executor->cancel();
+    spin_thread.join();
+    return ok;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args = rclcpp::init_and_remove_ros_arguments(argc, argv);
+    BenchConfig config = parseArgs(args);
+    std::printf("executor,rate_hz,beams,scans,samples,latency_mean_us,latency_p50_us,"
+        "latency_p99_us,latency_max_us,jitter_us,cpu_percent,"
+        "cycles_per_scan,instructions_per_scan,cache_misses_per_scan,branch_misses_per_scan\n");
+    int failures = 0;
+    for (const auto &type : config.executors) {
+        for (double rate : config.rates) {
+            for (int beams : config.beams) {
+                if (!rclcpp::ok()) break;
+                if (!runCase(config, type, rate, beams)) ++failures;
+            }
+        }
+    }
+    rclcpp::shutdown();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+// Times each ScanData kernel and the whole scan callback body (dataUpdate ->
+// deskew -> WallFollower::step) on a simulated scan, without ROS. Unless
+// --no-perf is given, hardware counters from perf_event_open are reported per
+// call next to the wall time; counters the board does not provide are left
+// empty. Output is CSV on stdout, one line per (kernel, beams), with --label
+// (default: host name) in the first column so runs from several boards and
+// commits can be concatenated and compared.
+//
+// usage: scan_data_benchmark [--params yaml] [--beams 360,720,1440] [--iterations n]
+//                            [--label name] [--no-perf]
+
+#include "wall_tracking_executor/PerfCounters.hpp"
+#include "wall_tracking_executor/Simulator.hpp"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace WallTracking;
+
+namespace {
+struct BenchConfig
+{
+    std::string params = "config/wall_tracking_executor.param.yaml";
+    std::vector<int> beams{360, 720, 1440};
+    int iterations = 20000;
+    std::string label;
+    bool perf = true;
+};
+
+struct Kernel
+{
+    const char *name;
+    std::function<float()> run;
+};
+
+BenchConfig parseArgs(int argc, char *argv[])
+{
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--params" && has_value) config.params = argv[++i];
+        else if (a == "--beams" && has_value) {
+            config.beams.clear();
+            std::stringstream ss(argv[++i]);
+            std::string item;
+            while (std::getline(ss, item, ',')) config.beams.push_back(std::stoi(item));
+        }
+        else if (a == "--iterations" && has_value) config.iterations = std::stoi(argv[++i]);
+        else if (a == "--label" && has_value) config.label = argv[++i];
+        else if (a == "--no-perf") config.perf = false;
+        else std::cerr << "ignoring unknown argument: " << a << std::endl;
+    }
+    if (config.label.empty()) {
+        char host[256] = {};
+        config.label = gethostname(host, sizeof(host) - 1) == 0 ? host : "unknown";
+    }
+    return config;
+}
+
+void printPerCall(std::int64_t value, int iterations)
+{
+    if (value < 0) std::printf(",");
+    else std::printf(",%.1f", static_cast<double>(value) / iterations);
+}
+
+volatile float sink; //計算結果を捨てられないようにする
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    BenchConfig config = parseArgs(argc, argv);
+    std::string err;
+    ControlParams params;
+    if (!loadControlParams(config.params, params, err)) {
+        std::cerr << "failed to load parameters: " << err << std::endl;
+        return 1;
+    }
+    World world;
+    Pose2D start;
+    if (!makeWorld("loop", params.distance_from_wall, world, start, err)) {
+        std::cerr << "failed to load world: " << err << std::endl;
+        return 1;
+    }
+    PerfCounters counters;
+    if (config.perf && !counters.open(false, err)) {
+        std::cerr << "hardware counters unavailable, timing only: " << err << std::endl;
+    }
+
+    std::printf("label,kernel,beams,iterations,ns_per_call,cycles,instructions,ipc,cache_misses,branch_misses\n");
+    for (int beams : config.beams) {
+        LidarModel model;
+        model.beams = beams;
+        LidarSimulator lidar(model);
+        std::mt19937 rng(1);
+        std::vector<float> ranges;
+        RangeView view = lidar.scan(world, start.x, start.y, start.yaw, rng);
+        ranges.assign(view.begin(), view.end());
+        // シミュレータのスキャンは瞬時に取れるので、10Hzで回るLiDARとしてdeskewさせる
+        ScanGeometry geometry = lidar.geometry();
+        geometry.time_increment = 0.1f / static_cast<float>(beams);
+
+        ScanData scan(static_cast<std::size_t>(beams));
+        scan.dataUpdate(RangeView(ranges), geometry);
+        WallFollower follower;
+        follower.setParams(params);
+        FollowerInput indoor, outdoor;
+        indoor.navigating = outdoor.navigating = true;
+        outdoor.outdoor = true;
+        outdoor.gnss_nan = false;
+        const float v = params.max_linear_vel, w = params.max_angular_vel;
+
+        // 補正済みのスキャンに対するdeskewは何もしないので、毎回dataUpdateで元のスキャンに戻す
+        std::vector<Kernel> kernels{
+            {"dataUpdate", [&] { scan.dataUpdate(RangeView(ranges), geometry); return 0.f; }},
+            {"deskew", [&] { scan.dataUpdate(RangeView(ranges), geometry); scan.deskew(v, w); return 0.f; }},
+            {"frontWallCheck", [&] { return scan.frontWallCheck(params.fwc_deg, params.distance_to_stop); }},
+            {"leftWallCheck", [&] {
+                return scan.leftWallCheck(params.start_deg_lateral, params.end_deg_lateral); }},
+            {"openPlaceCheck", [&] {
+                float per, mean;
+                scan.openPlaceCheck(-90., 90., params.open_place_distance, per, mean);
+                return per + mean; }},
+            {"conflictCheck", [&] {
+                return static_cast<float>(scan.conflictCheck(params.start_deg_lateral, params.distance_from_wall)); }},
+            {"thresholdCheck", [&] { return static_cast<float>(scan.thresholdCheck(params.flw_deg, 1.91)); }},
+            {"noiseCheck", [&] { return static_cast<float>(scan.noiseCheck(params.flw_deg)); }},
+            {"step_indoor", [&] { return follower.step(scan, indoor).angular_z; }},
+            {"step_outdoor", [&] { return follower.step(scan, outdoor).angular_z; }},
+            {"callback", [&] {
+                scan.dataUpdate(RangeView(ranges), geometry);
+                scan.deskew(v, w);
+                return follower.step(scan, outdoor).angular_z; }},
+        };
+        for (const auto &kernel : kernels) {
+            // ウォームアップでキャッシュと分岐予測を温めておく
+            for (int i = 0; i < config.iterations / 10; ++i) sink = kernel.run();
+            follower.reset();
+            if (counters.available()) counters.start();
+            auto begin = std::chrono::steady_clock::now();
+            for (int i = 0; i < config.iterations; ++i) sink = kernel.run();
+            double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            PerfSample s = counters.available() ? counters.stop() : PerfSample();
+            std::printf("%s,%s,%d,%d,%.1f", config.label.c_str(), kernel.name, beams, config.iterations,
+                sec * 1e9 / config.iterations);
+            printPerCall(s.cycles, config.iterations);
+            printPerCall(s.instructions, config.iterations);
+            if (s.cycles > 0 && s.instructions >= 0) {
+                std::printf(",%.2f", static_cast<double>(s.instructions) / static_cast<double>(s.cycles));
+            } else {
+                std::printf(",");
+            }
+            printPerCall(s.cache_misses, config.iterations);
+            printPerCall(s.branch_misses, config.iterations);
+            std::printf("\n");
+        }
+    }
+    return 0;
+}
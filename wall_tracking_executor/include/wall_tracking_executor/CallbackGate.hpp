@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CALLBACKGATE__CALLBACKGATE_HPP_
+#define CALLBACKGATE__CALLBACKGATE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace WallTracking{
+// Lets a teardown wait until no callback is running inside the gate.
+// Callbacks enter through a Guard; close() stops new entries and returns once
+// every callback that already entered has left. Entering never blocks.
+class CallbackGate
+{
+private:
+    std::atomic<bool> open_;
+    std::atomic<int> inside_;
+public:
+    CallbackGate() : open_(false), inside_(0) {}
+    void open() { open_ = true; }
+    void close()
+    {
+        open_ = false;
+        while (inside_.load() != 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    class Guard
+    {
+    private:
+        CallbackGate &gate_;
+        bool entered_;
+    public:
+        explicit Guard(CallbackGate &gate) : gate_(gate), entered_(false)
+        {
+            // 先に数を増やしてから確認するので、closeとすれ違っても取りこぼさない
+            gate_.inside_.fetch_add(1);
+            entered_ = gate_.open_.load();
+            if (!entered_) gate_.inside_.fetch_sub(1);
+        }
+        ~Guard() { if (entered_) gate_.inside_.fetch_sub(1); }
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+        explicit operator bool() const { return entered_; }
+    };
+};
+} // namespace WallTracking
+#endif // CALLBACKGATE__CALLBACKGATE_HPP_
@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CLOUDPROJECTOR__CLOUDPROJECTOR_HPP_
+#define CLOUDPROJECTOR__CLOUDPROJECTOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "wall_tracking_executor/RangeView.hpp"
+#include "wall_tracking_executor/ScanData.hpp"
+
+namespace WallTracking{
+// Height slice and virtual scan layout (m, deg) in the cloud's own frame
+struct CloudSliceConfig
+{
+    float min_height = -0.1, max_height = 0.5;
+    float angle_min_deg = -180., angle_max_deg = 180., angle_increment_deg = 0.25;
+    float range_min = 0.1, range_max = 30.;
+};
+
+// Raw PointCloud2 buffer description. x, y and z must be FLOAT32 in host byte order.
+struct CloudLayout
+{
+    const std::uint8_t *data = nullptr;
+    std::size_t width = 0, height = 0;
+    std::size_t point_step = 0, row_step = 0;
+    std::size_t x_offset = 0, y_offset = 0, z_offset = 0;
+};
+
+// Projects the points inside a height slice into range bins (nearest point wins),
+// producing a LaserScan-like range array that ScanData can read in place.
+class CloudProjector
+{
+private:
+    // 1チャンク分の点をスタック上の配列に並べ替えてからまとめて計算する
+    static constexpr std::size_t kChunk = 256;
+
+    CloudSliceConfig config_;
+    ScanGeometry geometry_;
+    std::vector<float> bins_; //末尾の1要素はスライス外の点の捨て場
+    std::size_t size_;
+    std::size_t points_in_slice_;
+
+    void projectChunk(const float *x, const float *y, const float *z, std::size_t n);
+public:
+    CloudProjector();
+    bool configure(const CloudSliceConfig &config, std::string &err);
+    // Returns false if the layout does not fit in the buffer
+    bool project(const CloudLayout &cloud);
+    RangeView ranges() const { return RangeView(bins_.data(), size_); }
+    const ScanGeometry &geometry() const { return geometry_; }
+    std::size_t size() const { return size_; }
+    std::size_t pointsInSlice() const { return points_in_slice_; }
+};
+} // namespace WallTracking
+#endif // CLOUDPROJECTOR__CLOUDPROJECTOR_HPP_
@@ -0,0 +1,40 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CONTROLPARAMS__CONTROLPARAMS_HPP_
+#define CONTROLPARAMS__CONTROLPARAMS_HPP_
+
+#include <string>
+
+namespace WallTracking{
+// Tunable control parameters plus the geometry derived from them.
+// Trivially copyable so that it can be swapped in through a SeqLock.
+struct ControlParams
+{
+    static constexpr int kMaxSectors = 16;
+
+    float distance_from_wall = 0.;
+    float distance_to_stop = 0.;
+    float max_linear_vel = 0.;
+    float max_angular_vel = 0., min_angular_vel = 0.;
+    float sampling_rate = 0.;
+    float kp = 0., ki = 0., kd = 0.;
+    int start_deg_lateral = 0, end_deg_lateral = 0;
+    float stop_ray_th = 0.;
+    float wheel_separation = 0.;
+    float distance_to_skip = 0.;
+    float open_place_distance = 0.;
+    int sector_num = 0;
+    float detection_div_deg[2 * kMaxSectors] = {};
+    float select_angvel[kMaxSectors] = {};
+
+    // 以下はcomputeDerivedで計算する
+    float fwc_deg = 0.; //前方の壁との距離をチェックする際に使用するレーザーの開始角度と終了角度
+    float flw_deg = 0.;
+    float vel_open_place = 0.;
+};
+
+// Validates p and fills its derived fields. Returns false with a reason in err.
+bool computeDerived(ControlParams &p, std::string &err);
+} // namespace WallTracking
+#endif // CONTROLPARAMS__CONTROLPARAMS_HPP_
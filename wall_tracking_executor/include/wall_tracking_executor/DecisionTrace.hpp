@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef DECISIONTRACE__DECISIONTRACE_HPP_
+#define DECISIONTRACE__DECISIONTRACE_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "wall_tracking_executor/SpscQueue.hpp"
+#include "wall_tracking_executor/WallFollower.hpp"
+
+namespace WallTracking{
+// One WallFollower step in the trace file. Fixed layout, little endian, no padding holes.
+struct TraceRecord
+{
+    enum Flags : std::uint8_t
+    {
+        OPEN_PLACE = 1 << 0,
+        GAP_START = 1 << 1,
+        GAP_END = 1 << 2,
+        FRONT_LEFT_WALL = 1 << 3,
+    };
+
+    std::int64_t stamp_ns = 0;
+    std::uint64_t seq = 0;
+    std::uint8_t action = 0; //FollowAction
+    std::uint8_t flags = 0;
+    std::int8_t sector_num = 0;
+    std::int8_t max_index = -1;
+    float linear_x = 0., angular_z = 0.;
+    float open_place_ratio = 0., open_place_mean = 0.;
+    float front_wall_ratio = 0., lateral_mean = 0.;
+    float pid_p = 0., pid_i = 0., pid_d = 0.;
+    float evals[ControlParams::kMaxSectors + 1] = {};
+    float means[ControlParams::kMaxSectors + 1] = {};
+};
+
+TraceRecord toTraceRecord(std::int64_t stamp_ns, const Decision &decision);
+
+// Appends TraceRecords to a file from a background thread.
+// push() only copies into a preallocated queue; when the writer falls behind records are dropped and counted.
+class DecisionTraceWriter
+{
+private:
+    std::unique_ptr<SpscQueue<TraceRecord>> queue_;
+    std::FILE *file_;
+    std::thread thread_;
+    std::atomic<bool> stop_;
+    std::uint64_t seq_;
+    std::atomic<std::uint64_t> written_, dropped_;
+    std::string moved_to_;
+    void run();
+public:
+    DecisionTraceWriter();
+    ~DecisionTraceWriter();
+    DecisionTraceWriter(const DecisionTraceWriter &) = delete;
+    DecisionTraceWriter &operator=(const DecisionTraceWriter &) = delete;
+    // Appends to an existing trace after dropping a torn last record; seq continues from it.
+    // A file with another layout is renamed to path.prev* (see movedAside) and a new one is started.
+    bool open(const std::string &path, std::size_t queue_capacity, std::string &err);
+    const std::string &movedAside() const { return moved_to_; }
+    // Flushes everything queued so far and closes the file. Frees the queue, so the
+    // thread calling push() must have stopped first (WallTracking closes its scan gate).
+    void close();
+    bool isOpen() const { return file_ != nullptr; }
+    // Call from a single thread only
+    void push(const TraceRecord &record);
+    std::uint64_t written() const { return written_; }
+    std::uint64_t dropped() const { return dropped_; }
+};
+
+bool readDecisionTrace(const std::string &path, std::vector<TraceRecord> &records, std::string &err);
+} // namespace WallTracking
+#endif // DECISIONTRACE__DECISIONTRACE_HPP_
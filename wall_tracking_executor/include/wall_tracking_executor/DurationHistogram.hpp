@@ -0,0 +1,36 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef DURATIONHISTOGRAM__DURATIONHISTOGRAM_HPP_
+#define DURATIONHISTOGRAM__DURATIONHISTOGRAM_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace WallTracking{
+// Percentiles of a duration over a window, read back as bucket upper edges
+struct DurationSummary
+{
+    std::uint64_t count = 0;
+    float p50 = 0., p90 = 0., p99 = 0., max = 0.; //s
+};
+
+// Lock-free log-scale histogram of durations. One thread records, any thread takes
+// the summary, which also starts the next window. Buckets are 2^(1/4) wide from 1 us,
+// so a percentile is at most 19% above the true value.
+class DurationHistogram
+{
+public:
+    static constexpr int kBuckets = 96;
+private:
+    std::array<std::atomic<std::uint32_t>, kBuckets> counts_;
+    std::atomic<float> max_;
+public:
+    DurationHistogram();
+    void record(float seconds);
+    DurationSummary takeSummary();
+    static float bucketUpperEdge(int bucket);
+};
+} // namespace WallTracking
+#endif // DURATIONHISTOGRAM__DURATIONHISTOGRAM_HPP_
@@ -0,0 +1,18 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef EXECUTOR_FACTORY__EXECUTOR_FACTORY_HPP_
+#define EXECUTOR_FACTORY__EXECUTOR_FACTORY_HPP_
+
+#include <rclcpp/rclcpp.hpp>
+#include <string>
+#include <vector>
+
+namespace WallTracking{
+// type: "single_threaded", "multi_threaded", "static_single_threaded" or "events".
+// threads is only used by multi_threaded (0 = number of cores).
+// Throws std::invalid_argument for an unknown or unavailable type.
+rclcpp::Executor::SharedPtr createExecutor(const std::string &type, std::size_t threads);
+std::vector<std::string> availableExecutorTypes();
+} // namespace WallTracking
+#endif // EXECUTOR_FACTORY__EXECUTOR_FACTORY_HPP_
@@ -0,0 +1,27 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef FASTMATH__FASTMATH_HPP_
+#define FASTMATH__FASTMATH_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace WallTracking{
+// Branch-free atan2 (max error about 1e-5 rad) that the compiler can inline and vectorize,
+// unlike the libm call. Returns 0 for (0, 0); NaN inputs give NaN.
+inline float atan2Approx(float y, float x)
+{
+    const float ax = std::fabs(x), ay = std::fabs(y);
+    // 0除算を避ける分岐を作らないよう、分母は正規化数の最小値で下から抑える
+    const float a = std::min(ax, ay) / std::max(std::max(ax, ay), std::numeric_limits<float>::min());
+    // [0, 1]でのatanのミニマックス近似
+    const float s = a * a;
+    float r = ((((0.0208351f * s - 0.0851330f) * s + 0.1801410f) * s - 0.3302995f) * s + 0.9998660f) * a;
+    r = ay > ax ? 1.57079637f - r : r;
+    r = x < 0.f ? 3.14159274f - r : r;
+    return std::copysign(r, y);
+}
+} // namespace WallTracking
+#endif // FASTMATH__FASTMATH_HPP_
@@ -0,0 +1,33 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef FILEROTATION__FILEROTATION_HPP_
+#define FILEROTATION__FILEROTATION_HPP_
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+
+namespace WallTracking{
+// Renames path to path.prev (path.prev1, path.prev2, ... if taken) so that a recording
+// file with an unexpected layout is kept instead of being overwritten.
+inline bool moveAside(const std::string &path, std::string &moved_to, std::string &err)
+{
+    struct stat st;
+    for (int i = 0; i < 100; ++i) {
+        std::string candidate = path + ".prev" + (i == 0 ? std::string() : std::to_string(i));
+        if (stat(candidate.c_str(), &st) == 0) continue;
+        if (std::rename(path.c_str(), candidate.c_str()) != 0) {
+            err = path + ": " + std::strerror(errno);
+            return false;
+        }
+        moved_to = candidate;
+        return true;
+    }
+    err = path + ": too many previous files, remove some " + path + ".prev*";
+    return false;
+}
+} // namespace WallTracking
+#endif // FILEROTATION__FILEROTATION_HPP_
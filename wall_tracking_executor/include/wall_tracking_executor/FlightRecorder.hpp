@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef FLIGHTRECORDER__FLIGHTRECORDER_HPP_
+#define FLIGHTRECORDER__FLIGHTRECORDER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "wall_tracking_executor/ControlParams.hpp"
+#include "wall_tracking_executor/RangeView.hpp"
+
+namespace WallTracking{
+// One scan's features as stored in the flight recorder file (fixed layout)
+struct FlightRecord
+{
+    enum Flags : std::uint8_t
+    {
+        TRACKING = 1 << 0,
+        OPEN_PLACE = 1 << 1,
+        GAP_START = 1 << 2,
+        GAP_END = 1 << 3,
+        FRONT_LEFT_WALL = 1 << 4,
+        OUTDOOR = 1 << 5,
+        DESKEW = 1 << 6,
+        DEADLINE_MISS = 1 << 7,
+    };
+
+    std::uint64_t seq = 0; //recordで付ける。0は書き込み途中のスロット
+    std::int64_t stamp_ns = 0;
+    float scan_age = 0., scan_duration = 0.; //s
+    float cmd_linear_x = 0., cmd_angular_z = 0.;
+    float lateral_mean = 0., front_wall_ratio = 0.;
+    float open_place_ratio = 0., open_place_mean = 0.;
+    float pid_p = 0., pid_i = 0., pid_d = 0.;
+    float evals[ControlParams::kMaxSectors + 1] = {};
+    std::uint16_t range_count = 0;
+    std::int16_t max_index = -1;
+    std::uint8_t action = 0; //FollowAction
+    std::uint8_t flags = 0;
+    std::uint8_t sector_num = 0;
+    std::uint8_t reserved = 0;
+};
+
+// Fixed-size ring of FlightRecords (plus optional raw ranges) in a memory-mapped file.
+// record() only copies into the mapping, so it neither allocates nor makes syscalls;
+// the kernel writes the pages back, and they survive a crash of the process.
+class FlightRecorder
+{
+private:
+    int fd_;
+    std::uint8_t *map_; //先頭にヘッダ、その後ろにスロットが並ぶ
+    std::size_t map_size_;
+    std::uint8_t *slots_;
+    std::size_t slot_size_, slot_count_, max_ranges_;
+    std::string moved_to_;
+public:
+    FlightRecorder();
+    ~FlightRecorder();
+    FlightRecorder(const FlightRecorder &) = delete;
+    FlightRecorder &operator=(const FlightRecorder &) = delete;
+    // Reuses an existing file with the same layout and keeps appending after its last record.
+    // A file with another layout is renamed to path.prev* (see movedAside), never overwritten.
+    bool open(const std::string &path, std::size_t slot_count, std::size_t max_ranges, std::string &err);
+    const std::string &movedAside() const { return moved_to_; }
+    void close();
+    bool isOpen() const { return map_ != nullptr; }
+    // Ranges beyond max_ranges are cut off
+    void record(const FlightRecord &record, RangeView ranges);
+    std::uint64_t recorded() const;
+};
+
+// Reads every complete record in sequence order. ranges (optional) gets max_ranges floats per record.
+bool readFlightRecords(const std::string &path, std::vector<FlightRecord> &records,
+    std::vector<float> *ranges, std::size_t &max_ranges, std::string &err);
+} // namespace WallTracking
+#endif // FLIGHTRECORDER__FLIGHTRECORDER_HPP_
@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef LOADGOVERNOR__LOADGOVERNOR_HPP_
+#define LOADGOVERNOR__LOADGOVERNOR_HPP_
+
+#include <cstdint>
+
+namespace WallTracking{
+// Optional processing is shed in this order as the level rises
+enum class LoadLevel : std::uint8_t
+{
+    FULL,           // 全処理を行う
+    NO_DEBUG,       // デバッグ出力(判断トレース、距離の記録、handover_latency、behavior_stamped)を止める
+    NO_DESKEW,      // deskewも止める
+    REDUCED_SECTORS // 開けた場所の判定を正面に近い扇形に絞る
+};
+
+const char *toString(LoadLevel level);
+
+struct GovernorConfig
+{
+    float budget = 0.; //s, 0以下なら常にFULL
+    float degrade_ratio = 1.; //平均がbudgetのこの割合を超えたら1段下げる
+    float recover_ratio = 0.6; //この割合を下回ったら1段戻す
+    int degrade_scans = 5;
+    int recover_scans = 100;
+};
+
+// Steps the load level from the scan callback duration. The duration is smoothed,
+// and a step needs degrade_scans (recover_scans) consecutive scans beyond the
+// threshold; the gap between the two ratios keeps it from flapping.
+class LoadGovernor
+{
+private:
+    GovernorConfig config_;
+    LoadLevel level_;
+    float mean_duration_;
+    int over_scans_, under_scans_;
+public:
+    LoadGovernor();
+    void configure(const GovernorConfig &config);
+    void reset();
+    // Returns true when the level changed
+    bool update(float duration);
+    LoadLevel level() const { return level_; }
+    float meanDuration() const { return mean_duration_; }
+    bool debugOutputs() const { return level_ < LoadLevel::NO_DEBUG; }
+    bool deskew() const { return level_ < LoadLevel::NO_DESKEW; }
+    bool allSectors() const { return level_ < LoadLevel::REDUCED_SECTORS; }
+};
+} // namespace WallTracking
+#endif // LOADGOVERNOR__LOADGOVERNOR_HPP_
@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef PERFCOUNTERS__PERFCOUNTERS_HPP_
+#define PERFCOUNTERS__PERFCOUNTERS_HPP_
+
+#include <cstdint>
+#include <string>
+
+namespace WallTracking{
+// Counter values over one start()/stop() window; -1 when the counter is unavailable
+struct PerfSample
+{
+    std::int64_t cycles = -1, instructions = -1;
+    std::int64_t cache_misses = -1, branch_misses = -1;
+};
+
+// Hardware counters from perf_event_open for the calling thread (user space only).
+// Each counter is opened on its own, so a board or VM that lacks one of them still
+// reports the others; values are scaled when the kernel multiplexes them.
+class PerfCounters
+{
+public:
+    enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTER_NUM };
+private:
+    int fd_[COUNTER_NUM];
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+    // inherit also counts threads created by the calling thread after open.
+    // Returns false (with the reason in err) only when no counter could be opened.
+    bool open(bool inherit, std::string &err);
+    void close();
+    bool available() const;
+    bool available(Counter counter) const { return fd_[counter] >= 0; }
+    void start();
+    PerfSample stop();
+};
+} // namespace WallTracking
+#endif // PERFCOUNTERS__PERFCOUNTERS_HPP_
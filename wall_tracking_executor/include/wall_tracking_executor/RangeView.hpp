@@ -0,0 +1,45 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef RANGEVIEW__RANGEVIEW_HPP_
+#define RANGEVIEW__RANGEVIEW_HPP_
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace WallTracking{
+// Non-owning view of a contiguous range buffer (C++17 stand-in for std::span<const float>).
+// The buffer may be a message, a loaned message, a driver buffer or a mapped log;
+// the owner must keep it alive while the view is in use.
+class RangeView
+{
+private:
+    const float *data_;
+    std::size_t size_;
+
+public:
+    constexpr RangeView() noexcept : data_(nullptr), size_(0) {}
+    constexpr RangeView(const float *data, std::size_t size) noexcept : data_(data), size_(size) {}
+    template<typename Alloc>
+    RangeView(const std::vector<float, Alloc> &v) noexcept : data_(v.data()), size_(v.size()) {}
+    template<std::size_t N>
+    constexpr RangeView(const std::array<float, N> &a) noexcept : data_(a.data()), size_(N) {}
+    template<std::size_t N>
+    constexpr RangeView(const float (&a)[N]) noexcept : data_(a), size_(N) {}
+
+    constexpr const float *data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr const float *begin() const noexcept { return data_; }
+    constexpr const float *end() const noexcept { return data_ + size_; }
+    constexpr const float &operator[](std::size_t i) const noexcept { return data_[i]; }
+
+    constexpr RangeView subview(std::size_t offset, std::size_t count) const noexcept
+    {
+        return offset >= size_ ? RangeView() :
+            RangeView(data_ + offset, count < size_ - offset ? count : size_ - offset);
+    }
+};
+} // namespace WallTracking
+#endif // RANGEVIEW__RANGEVIEW_HPP_
@@ -0,0 +1,18 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef REALTIME__REALTIME_HPP_
+#define REALTIME__REALTIME_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace WallTracking{
+// Each function returns false and fills err when the process lacks the
+// privilege (or the platform lacks support), so callers can fall back.
+bool setThreadAffinity(int cpu, std::string &err);
+bool setThreadFifoPriority(int priority, std::string &err);
+bool lockProcessMemory(std::size_t prefault_heap_bytes, std::string &err);
+void prefaultStack(std::size_t bytes);
+} // namespace WallTracking
+#endif // REALTIME__REALTIME_HPP_
@@ -9,9 +9,29 @@
 
 #include <vector>
 #include <cmath>
-#include <sensor_msgs/msg/laser_scan.hpp>
+#include <cstddef>
+#include <cstdint>
+
+#include "wall_tracking_executor/RangeView.hpp"
 
 namespace WallTracking{
+// Scan geometry in the same units as sensor_msgs/LaserScan (rad, s, m)
+struct ScanGeometry
+{
+    float angle_min = 0., angle_max = 0., angle_increment = 0.;
+    float time_increment = 0.;
+    float range_min = 0., range_max = 0.;
+};
+
+inline bool operator==(const ScanGeometry &a, const ScanGeometry &b)
+{
+    return a.angle_min == b.angle_min && a.angle_max == b.angle_max &&
+        a.angle_increment == b.angle_increment && a.time_increment == b.time_increment &&
+        a.range_min == b.range_min && a.range_max == b.range_max;
+}
+
+inline bool operator!=(const ScanGeometry &a, const ScanGeometry &b) { return !(a == b); }
+
 class ScanData
 {
 private:
@@ -19,12 +39,36 @@ private:
     float angle_increment_;
     float range_min_, range_max_;
 
-    std::vector<float> ranges_;
-    sensor_msgs::msg::LaserScan::ConstSharedPtr tmp_scan_msg_;
+    float time_increment_;
+
+    ScanGeometry geometry_;
+    std::vector<float> ranges_; //deskew後のレンジ
+    const float *data_; //呼び出し側のバッファを参照する(コピーしない)
+    std::size_t size_;
+
+    // deskew用に事前計算するビームごとのテーブル
+    std::vector<float> beam_cos_, beam_sin_, beam_dt_;
+    // ビームの時刻ずれの間の旋回 (角速度が変わったときだけ計算し直す)
+    std::vector<float> rot_cos_, rot_sin_, shift_x_, shift_y_;
+    float deskew_angular_z_;
+    std::vector<float> px_, py_;
+    std::vector<std::uint8_t> hit_;
+    void initBeamTable(std::size_t size);
+    void updateDeskewTable(float angular_z);
+    void setGeometry(const ScanGeometry &geometry, std::size_t size);
 public:
-    ScanData(sensor_msgs::msg::LaserScan::ConstSharedPtr msg);
+    explicit ScanData(std::size_t capacity);
     ~ScanData();
-    void dataUpdate(sensor_msgs::msg::LaserScan::ConstSharedPtr msg);
+    // ranges must stay valid until the next dataUpdate (no copy is made)
+    void dataUpdate(RangeView ranges, const ScanGeometry &geometry);
+    void dataUpdate(const float *ranges, std::size_t size, const ScanGeometry &geometry)
+    {
+        dataUpdate(RangeView(ranges, size), geometry);
+    }
+    std::size_t size() const { return size_; }
+    RangeView ranges() const { return RangeView(data_, size_); }
+    // Corrects the scan given by the last dataUpdate; later calls before the next dataUpdate do nothing
+    void deskew(float linear_x, float angular_z);
     float frontWallCheck(float start_deg, float threshold);
     float leftWallCheck(float start_deg, float end_deg);
     void openPlaceCheck(float start_deg, float end_deg, float threshold, float &per, float &mean_l);
@@ -35,5 +79,5 @@ public:
     float index2deg(int index);
     float index2rad(int index);
 };
-} // namespace ScanData
+} // namespace WallTracking
 #endif // SCANDATA__SCANDATA_HPP_
\ No newline at end of file
@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef SCANFUSER__SCANFUSER_HPP_
+#define SCANFUSER__SCANFUSER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "wall_tracking_executor/RangeView.hpp"
+#include "wall_tracking_executor/ScanData.hpp"
+
+namespace WallTracking{
+// Static mounting pose of a lidar in the base frame (m, deg)
+struct SensorPose
+{
+    float x = 0., y = 0., yaw_deg = 0.;
+};
+
+// Layout of the fused virtual scan in the base frame (m, deg)
+struct VirtualScanConfig
+{
+    float angle_min_deg = -180., angle_max_deg = 180., angle_increment_deg = 0.25;
+    float range_min = 0.05, range_max = 30.;
+};
+
+// Merges N laser scans with known static poses into one virtual scan (nearest return wins).
+// Every buffer is sized in configure(); update() and fuse() do not allocate
+// as long as each sensor stays within its beam capacity.
+class ScanFuser
+{
+private:
+    static constexpr std::size_t kChunk = 256;
+
+    struct Sensor
+    {
+        SensorPose pose;
+        ScanGeometry geometry;
+        std::vector<float> ranges;
+        std::vector<float> beam_cos, beam_sin; //ベース座標系でのビーム方向
+        std::size_t size = 0;
+        std::int64_t stamp_ns = 0;
+        bool received = false;
+    };
+
+    VirtualScanConfig config_;
+    ScanGeometry geometry_;
+    std::vector<Sensor> sensors_;
+    std::vector<float> bins_; //末尾の1要素は範囲外のビームの捨て場
+    std::size_t size_;
+    std::size_t sensors_fused_;
+
+    void scatter(const Sensor &sensor, float dx, float dy, float dth);
+public:
+    ScanFuser();
+    bool configure(const VirtualScanConfig &config, const std::vector<SensorPose> &poses,
+        std::size_t beam_capacity, std::string &err);
+    // Copies one sensor's scan into its preallocated slot. Returns false if it exceeds the capacity.
+    bool update(std::size_t sensor, std::int64_t stamp_ns, RangeView ranges, const ScanGeometry &geometry);
+    // Builds the virtual scan at stamp_ns from every sensor no older than max_skew_ns,
+    // moving older scans forward with a constant twist (m/s, rad/s). Returns the number of sensors merged.
+    std::size_t fuse(std::int64_t stamp_ns, std::int64_t max_skew_ns, float linear_x, float angular_z);
+    RangeView ranges() const { return RangeView(bins_.data(), size_); }
+    const ScanGeometry &geometry() const { return geometry_; }
+    // Newest stamp among the sensors received so far (0 if none)
+    std::int64_t newestStamp() const;
+    std::size_t sensorCount() const { return sensors_.size(); }
+    std::size_t sensorsFused() const { return sensors_fused_; }
+};
+} // namespace WallTracking
+#endif // SCANFUSER__SCANFUSER_HPP_
@@ -0,0 +1,40 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef SCANWATCHDOG__SCANWATCHDOG_HPP_
+#define SCANWATCHDOG__SCANWATCHDOG_HPP_
+
+#include <cstdint>
+
+namespace WallTracking{
+// Tracks inter-scan intervals. Times are in seconds on any monotonic base.
+class ScanWatchdog
+{
+private:
+    double timeout_;
+    double gap_factor_;
+    double last_scan_time_;
+    double mean_interval_;
+    double max_interval_;
+    uint64_t scan_count_;
+    uint64_t gap_count_;
+    uint64_t timeout_count_;
+    bool timed_out_;
+public:
+    ScanWatchdog(double timeout, double gap_factor);
+    // Returns the interval since the previous scan (0 for the first one).
+    double scanReceived(double now);
+    // Returns true on the transition into the timed-out state.
+    bool check(double now);
+    void reset();
+    bool timedOut() const { return timed_out_; }
+    double timeSinceLastScan(double now) const;
+    double scanRate() const;
+    double meanInterval() const { return mean_interval_; }
+    double maxInterval() const { return max_interval_; }
+    uint64_t scanCount() const { return scan_count_; }
+    uint64_t gapCount() const { return gap_count_; }
+    uint64_t timeoutCount() const { return timeout_count_; }
+};
+} // namespace WallTracking
+#endif // SCANWATCHDOG__SCANWATCHDOG_HPP_
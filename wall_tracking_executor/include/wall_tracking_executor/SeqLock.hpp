@@ -0,0 +1,66 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef SEQLOCK__SEQLOCK_HPP_
+#define SEQLOCK__SEQLOCK_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace WallTracking{
+// Single writer / multi reader handoff of the latest value.
+// The writer never blocks; a reader retries only if it raced a write.
+// The payload is stored as relaxed atomic words so a torn read is never UB,
+// it is just detected by the sequence counter and discarded.
+template<typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires a trivially copyable type");
+    static constexpr std::size_t kWords = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+private:
+    alignas(64) std::atomic<std::uint32_t> seq_;
+    std::array<std::atomic<std::uint64_t>, kWords> words_;
+
+public:
+    SeqLock() : seq_(0)
+    {
+        for (auto &w : words_) w.store(0, std::memory_order_relaxed);
+    }
+
+    explicit SeqLock(const T &init) : SeqLock() { store(init); }
+
+    void store(const T &value)
+    {
+        std::uint64_t buf[kWords] = {};
+        std::memcpy(buf, &value, sizeof(T));
+        std::uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < kWords; ++i) words_[i].store(buf[i], std::memory_order_relaxed);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const
+    {
+        std::uint64_t buf[kWords];
+        std::uint32_t seq0, seq1;
+        do {
+            seq0 = seq_.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < kWords; ++i) buf[i] = words_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq1 = seq_.load(std::memory_order_relaxed);
+        } while ((seq0 & 1) || seq0 != seq1);
+        T value;
+        std::memcpy(&value, buf, sizeof(T));
+        return value;
+    }
+
+    // Number of completed stores, usable by readers to detect a new snapshot.
+    std::uint32_t version() const { return seq_.load(std::memory_order_acquire) >> 1; }
+};
+} // namespace WallTracking
+#endif // SEQLOCK__SEQLOCK_HPP_
@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef SIMULATOR__SIMULATOR_HPP_
+#define SIMULATOR__SIMULATOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "wall_tracking_executor/ControlParams.hpp"
+#include "wall_tracking_executor/ScanData.hpp"
+#include "wall_tracking_executor/WallFollower.hpp"
+
+namespace WallTracking{
+// 2D world made of wall segments, stored as arrays so raycasting vectorizes
+class World
+{
+private:
+    std::vector<float> x0_, y0_, ex_, ey_; //始点と方向ベクトル
+public:
+    void addSegment(float x0, float y0, float x1, float y1);
+    // Consecutive points are joined; closed joins the last point back to the first
+    void addPolyline(const std::vector<float> &xy, bool closed);
+    // Text format: one polyline per line as "x0 y0 x1 y1 ...", '#' starts a comment
+    bool load(const std::string &path, std::string &err);
+    // Straight corridor along +x with a door-sized gap in the left wall
+    static World corridor(float length, float width);
+    // Rectangular ring corridor; makeWorld starts the robot in the bottom leg heading -x (yaw = pi)
+    // with the outer wall on its left, so it runs clockwise
+    static World loop(float outer_x, float outer_y, float width);
+    std::size_t segmentCount() const { return x0_.size(); }
+    float distanceToWall(float x, float y) const;
+    friend class LidarSimulator;
+};
+
+struct Pose2D
+{
+    float x = 0., y = 0., yaw = 0.;
+};
+
+// Builds "corridor", "loop" or a world file and the start pose that puts the wall
+// distance_from_wall to the robot's left (the origin for world files)
+bool makeWorld(const std::string &name, float distance_from_wall, World &world, Pose2D &start, std::string &err);
+
+struct LidarModel
+{
+    int beams = 720;
+    float angle_min_deg = -180., angle_max_deg = 180.;
+    float range_min = 0.05, range_max = 12.;
+    float noise_stddev = 0.01; //m
+    float dropout = 0.; //計測が抜ける確率
+};
+
+// Generates LaserScan-like ranges by casting every beam against every wall segment
+class LidarSimulator
+{
+private:
+    LidarModel model_;
+    ScanGeometry geometry_;
+    std::vector<float> beam_cos_, beam_sin_;
+    std::vector<float> dx_, dy_;
+    std::vector<float> ranges_;
+public:
+    explicit LidarSimulator(const LidarModel &model);
+    const ScanGeometry &geometry() const { return geometry_; }
+    RangeView scan(const World &world, float x, float y, float yaw, std::mt19937 &rng);
+};
+
+struct EpisodeConfig
+{
+    const World *world = nullptr;
+    ControlParams params;
+    LidarModel lidar;
+    Pose2D start;
+    float duration = 60.; //s
+    float mission_distance = 0.; //この距離を走ったら終了(0なら時間いっぱい走る)
+    float robot_radius = 0.2;
+    float turn_hold = 0.1; //実機では旋回指令の後に100ms待つ
+    int substeps = 4;
+    bool outdoor = false;
+    std::uint32_t seed = 0;
+};
+
+struct EpisodeResult
+{
+    float sim_time = 0.; //衝突または終了までの時間
+    float distance = 0.;
+    float rms_wall_error = 0.; //最寄りの壁との距離とdistance_from_wallの差
+    float max_wall_error = 0.;
+    std::uint64_t steps = 0, turns = 0, gap_skips = 0;
+    bool collided = false;
+    bool completed = false; //衝突せずにmission_distanceを走り切った
+    Pose2D final_pose;
+};
+
+// Runs one closed loop episode: simulated scan -> ScanData -> WallFollower -> diff drive
+EpisodeResult runEpisode(const EpisodeConfig &config);
+
+// Runs independent episodes on threads (0 = hardware concurrency); results keep the input order
+std::vector<EpisodeResult> runEpisodes(const std::vector<EpisodeConfig> &configs, std::size_t threads);
+
+// Reads the control parameters from a ROS 2 parameter yaml (the node's config file)
+bool loadControlParams(const std::string &path, ControlParams &p, std::string &err);
+} // namespace WallTracking
+#endif // SIMULATOR__SIMULATOR_HPP_
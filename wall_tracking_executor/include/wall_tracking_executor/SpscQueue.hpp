@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef SPSCQUEUE__SPSCQUEUE_HPP_
+#define SPSCQUEUE__SPSCQUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace WallTracking{
+// Bounded single producer / single consumer queue. push and pop never block or allocate;
+// push fails when the queue is full so the producer can count the drop and move on.
+template<typename T>
+class SpscQueue
+{
+private:
+    std::vector<T> buffer_;
+    std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> head_; //次に読む位置(consumerのみ書き込む)
+    alignas(64) std::atomic<std::size_t> tail_; //次に書く位置(producerのみ書き込む)
+
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscQueue(std::size_t capacity) : head_(0), tail_(0)
+    {
+        std::size_t size = 1;
+        while (size < capacity) size <<= 1;
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+
+    bool push(const T &value)
+    {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_) return false;
+        buffer_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        value = buffer_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t capacity() const { return buffer_.size(); }
+};
+} // namespace WallTracking
+#endif // SPSCQUEUE__SPSCQUEUE_HPP_
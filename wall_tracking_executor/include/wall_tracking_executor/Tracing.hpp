@@ -0,0 +1,28 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef TRACING__TRACING_HPP_
+#define TRACING__TRACING_HPP_
+
+// WALL_TRACKING_TRACEPOINT(event, args...) fires an LTTng-UST tracepoint defined in tp_call.h.
+// Without an active tracing session it costs one predictable branch and the arguments are
+// not evaluated. Built with -DWALL_TRACKING_TRACEPOINTS=OFF (or without lttng-ust) it compiles to nothing.
+#ifdef WALL_TRACKING_TRACEPOINTS_ENABLED
+#include "wall_tracking_executor/tp_call.h"
+#define WALL_TRACKING_TRACEPOINT(event, ...) tracepoint(wall_tracking_executor, event, __VA_ARGS__)
+#else
+#define WALL_TRACKING_TRACEPOINT(event, ...) ((void)0)
+#endif
+
+namespace WallTracking{
+// stage field of the sector_analysis tracepoint
+enum TraceStage : int
+{
+    TRACE_OPEN_PLACE = 0,
+    TRACE_FRONT_WALL = 1,
+    TRACE_SECTOR = 2,
+    TRACE_LEFT_WALL = 3,
+};
+} // namespace WallTracking
+
+#endif // TRACING__TRACING_HPP_
@@ -0,0 +1,71 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef WALLFOLLOWER__WALLFOLLOWER_HPP_
+#define WALLFOLLOWER__WALLFOLLOWER_HPP_
+
+#include <cstdint>
+#include "wall_tracking_executor/ControlParams.hpp"
+#include "wall_tracking_executor/ScanData.hpp"
+
+namespace WallTracking{
+enum class FollowAction : uint8_t
+{
+    STOP,       // ナビゲーションのゴールが無い
+    TURN,       // 前方に壁があるので旋回する
+    WALL_TRACK, // 左の壁に沿ってPID制御
+    GAP_SKIP,   // 壁の切れ目なので直進
+    OPEN_PLACE, // 開けた方向へ進む
+};
+
+struct FollowerInput
+{
+    bool outdoor = false;
+    bool gnss_nan = true;
+    bool navigating = false;
+    int sector_limit = 0; //評価する扇形を中心が正面(0°)に近い順にこの数に絞る(0なら全て)
+};
+
+// Result of one control step and the intermediate values that led to it
+struct Decision
+{
+    FollowAction action = FollowAction::STOP;
+    float linear_x = 0., angular_z = 0.;
+    bool open_place = false;
+    float open_place_ratio = 0., open_place_mean = 0.;
+    float front_wall_ratio = 0.;
+    bool gap_start = false, gap_end = false, front_left_wall = false;
+    float lateral_mean = 0.;
+    float pid_p = 0., pid_i = 0., pid_d = 0.;
+    int sector_num = 0, max_index = -1;
+    float evals[ControlParams::kMaxSectors + 1] = {};
+    float means[ControlParams::kMaxSectors + 1] = {};
+};
+
+// The wall following algorithm without any ROS dependency
+class WallFollower
+{
+private:
+    ControlParams params_;
+    float ei_, pre_e_;
+    bool open_place_;
+    float linear_vel_;
+    Decision decision_;
+    int sector_order_[ControlParams::kMaxSectors]; //中心が正面に近い順の扇形の番号
+
+    void sortSectors();
+    float lateralPidControl(float input);
+    void wallTracking(ScanData &scan);
+    void navigateOpenPlace(ScanData &scan, const FollowerInput &input);
+    void setCommand(FollowAction action, float linear_x, float angular_z);
+public:
+    WallFollower();
+    void setParams(const ControlParams &params);
+    const ControlParams &params() const { return params_; }
+    void reset();
+    const Decision &step(ScanData &scan, const FollowerInput &input);
+    const Decision &decision() const { return decision_; }
+    bool openPlace() const { return open_place_; }
+};
+} // namespace WallTracking
+#endif // WALLFOLLOWER__WALLFOLLOWER_HPP_
@@ -0,0 +1,65 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+// LTTng-UST tracepoint provider for the scan pipeline.
+// Use WALL_TRACKING_TRACEPOINT() from Tracing.hpp instead of including this directly.
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER wall_tracking_executor
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "wall_tracking_executor/tp_call.h"
+
+#if !defined(_WALL_TRACKING_EXECUTOR__TP_CALL_H_) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define _WALL_TRACKING_EXECUTOR__TP_CALL_H_
+
+#include <lttng/tracepoint.h>
+#include <stdint.h>
+
+// スキャンを受け取り、鮮度チェックを通った時点(ageは受信時点でのスキャンの古さ[s])
+TRACEPOINT_EVENT(
+  wall_tracking_executor, scan_receive,
+  TP_ARGS(int64_t, stamp_ns, float, age),
+  TP_FIELDS(
+    ctf_integer(int64_t, stamp_ns, stamp_ns)
+    ctf_float(float, age, age)))
+
+// ScanDataへの反映(deskewを含む)が終わった時点
+TRACEPOINT_EVENT(
+  wall_tracking_executor, scan_data_update,
+  TP_ARGS(int64_t, stamp_ns, uint32_t, beams, int, deskew),
+  TP_FIELDS(
+    ctf_integer(int64_t, stamp_ns, stamp_ns)
+    ctf_integer(uint32_t, beams, beams)
+    ctf_integer(int, deskew, deskew)))
+
+// 判断の各段階。stageはTracing.hppのTraceStage(扇形はindexに番号が入る)
+TRACEPOINT_EVENT(
+  wall_tracking_executor, sector_analysis,
+  TP_ARGS(int, stage, int, index, float, value),
+  TP_FIELDS(
+    ctf_integer(int, stage, stage)
+    ctf_integer(int, index, index)
+    ctf_float(float, value, value)))
+
+// WallFollowerが速度指令を決めた時点
+TRACEPOINT_EVENT(
+  wall_tracking_executor, control_computed,
+  TP_ARGS(int, action, float, linear_x, float, angular_z),
+  TP_FIELDS(
+    ctf_integer(int, action, action)
+    ctf_float(float, linear_x, linear_x)
+    ctf_float(float, angular_z, angular_z)))
+
+// cmd_velをpublishする直前
+TRACEPOINT_EVENT(
+  wall_tracking_executor, cmd_vel_publish,
+  TP_ARGS(const void *, publisher, float, linear_x, float, angular_z),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, publisher, publisher)
+    ctf_float(float, linear_x, linear_x)
+    ctf_float(float, angular_z, angular_z)))
+
+#endif  // _WALL_TRACKING_EXECUTOR__TP_CALL_H_
+
+#include <lttng/tracepoint-event.h>
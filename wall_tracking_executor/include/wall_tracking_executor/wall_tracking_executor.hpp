@@ -4,18 +4,38 @@
 #ifndef WALL_TRACKING__WALL_TRACKING_HPP_
 #define WALL_TRACKING__WALL_TRACKING_HPP_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <diagnostic_updater/diagnostic_updater.hpp>
+#include <mutex>
+#include <thread>
 #include <geometry_msgs/msg/twist.hpp>
 #include <rclcpp/qos.hpp>
 #include <rclcpp/rclcpp.hpp>
 #include <rclcpp_action/rclcpp_action.hpp>
+#include <rclcpp_lifecycle/lifecycle_node.hpp>
+#include <rclcpp_lifecycle/lifecycle_publisher.hpp>
 #include <sensor_msgs/msg/laser_scan.hpp>
 #include <sensor_msgs/msg/nav_sat_fix.hpp>
+#include <sensor_msgs/msg/point_cloud2.hpp>
 #include <std_msgs/msg/bool.hpp>
 #include <std_msgs/msg/string.hpp>
 #include <string>
 #include <vector>
 #include "wall_tracking_msgs/action/wall_tracking.hpp"
+#include "wall_tracking_executor/CallbackGate.hpp"
+#include "wall_tracking_executor/CloudProjector.hpp"
+#include "wall_tracking_executor/ControlParams.hpp"
+#include "wall_tracking_executor/DecisionTrace.hpp"
+#include "wall_tracking_executor/DurationHistogram.hpp"
+#include "wall_tracking_executor/FlightRecorder.hpp"
+#include "wall_tracking_executor/LoadGovernor.hpp"
 #include "wall_tracking_executor/ScanData.hpp"
+#include "wall_tracking_executor/ScanFuser.hpp"
+#include "wall_tracking_executor/SeqLock.hpp"
+#include "wall_tracking_executor/WallFollower.hpp"
+#include "wall_tracking_executor/ScanWatchdog.hpp"
 #include <geometry_msgs/msg/pose_with_covariance_stamped.hpp>
 #include <nav2_msgs/action/navigate_to_pose.hpp>
 #include <geometry_msgs/msg/pose_stamped.hpp>
@@ -23,35 +43,78 @@
 #include <wall_tracking_msgs/msg/behavior_stamped_array.hpp>
 #include <wall_tracking_msgs/msg/behavior_stamped.hpp>
 #include <geometry_msgs/msg/pose_array.hpp>
+#include <nav_msgs/msg/odometry.hpp>
 
 using WallTrackingAction = wall_tracking_msgs::action::WallTracking;
 using GoalHandleWallTracking = rclcpp_action::ServerGoalHandle<WallTrackingAction>;
 using NavigateToPose = nav2_msgs::action::NavigateToPose;
 using GoalHandleNavigateToPose = rclcpp_action::ClientGoalHandle<NavigateToPose>;
+using CallbackReturn = rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn;
 
 namespace WallTracking {
 
-class WallTracking : public rclcpp::Node {
+// Processed per-scan features handed from the scan callback to other threads
+struct ScanFeatures {
+	int64_t stamp_ns = 0;
+	float open_place_ratio = 0.;
+	float front_wall_ratio = 0.;
+	bool open_place = false;
+	bool outdoor = false;
+	bool tracking = false;
+	uint8_t action = 0; //FollowAction
+};
+
+class WallTracking : public rclcpp_lifecycle::LifecycleNode {
 public:
-	WallTracking();
+	explicit WallTracking(const rclcpp::NodeOptions & options = rclcpp::NodeOptions());
 	~WallTracking();
+	bool autostart() const;
+	bool realtimeMode() const;
+	// Features of the last processed scan; stamp_ns identifies the scan behind the latest cmd_vel
+	ScanFeatures latestScanFeatures() const;
+	rclcpp::CallbackGroup::SharedPtr scanCallbackGroup() const;
+	void configureRealtimeThread();
+	std::string executorType() const;
+	std::size_t executorThreads() const;
 
 protected:
+	CallbackReturn on_configure(const rclcpp_lifecycle::State & state) override;
+	CallbackReturn on_activate(const rclcpp_lifecycle::State & state) override;
+	CallbackReturn on_deactivate(const rclcpp_lifecycle::State & state) override;
+	CallbackReturn on_cleanup(const rclcpp_lifecycle::State & state) override;
+	CallbackReturn on_shutdown(const rclcpp_lifecycle::State & state) override;
+	void stop_goal();
+	void release();
 	void set_param();
-	void get_param();
+	bool get_param();
+	bool read_control_params(const std::vector<rclcpp::Parameter> & changes, ControlParams & p, std::string & err);
+	rcl_interfaces::msg::SetParametersResult parameters_callback(const std::vector<rclcpp::Parameter> & parameters);
+	void apply_pending_params();
+	void set_follower_params(const ControlParams & params);
+	void init_callback_group();
 	void init_sub();
 	void init_pub();
 	void init_action();
+	void init_timer();
+	void init_diagnostics();
 	void init_variable();
-	float lateral_pid_control(float input);
 	void turn();
-	void wallTracking();
 	void pub_cmd_vel(float linear_x, float anguler_z);
 	void scan_callback(sensor_msgs::msg::LaserScan::ConstSharedPtr msg);
+	void cloud_callback(sensor_msgs::msg::PointCloud2::ConstSharedPtr msg);
+	void fusion_scan_callback(sensor_msgs::msg::LaserScan::ConstSharedPtr msg, std::size_t sensor);
+	bool accept_scan(const rclcpp::Time & stamp);
+	void finish_scan(std::chrono::steady_clock::time_point start);
+	void record_decision(const rclcpp::Time & stamp, const Decision & decision);
+	bool debug_outputs() const;
+	void scan_process(const rclcpp::Time & stamp, RangeView ranges, const ScanGeometry & geometry);
+	void watchdog_callback();
+	void diagnose_scan(diagnostic_updater::DiagnosticStatusWrapper & stat);
+	void diagnose_behavior(diagnostic_updater::DiagnosticStatusWrapper & stat);
 	void gnss_callback(sensor_msgs::msg::NavSatFix::ConstSharedPtr msg);
-	void navigateOpenPlace();
+	void odom_callback(nav_msgs::msg::Odometry::ConstSharedPtr msg);
 	void pub_open_place_arrived(bool open_place_arrived);
-	void pub_open_place_detection(std::string open_place_detection);
+	void pub_open_place_detection(const char * open_place_detection);
 	void gnss_pose_with_covariance_callback(geometry_msgs::msg::PoseWithCovarianceStamped::ConstSharedPtr msg);
 	void goal_pose_callback(geometry_msgs::msg::PoseStamped::ConstSharedPtr msg);
 
@@ -72,6 +135,7 @@ protected:
 	void execute(
 		const std::shared_ptr<GoalHandleWallTracking> goal_handle
 	);
+	void goal_worker();
 
 	// For navigate_to_pose action client
 	void goalResponceCallback(const std::shared_ptr<GoalHandleNavigateToPose> &goal_handle);
@@ -83,52 +147,113 @@ protected:
 
 private:
 	rclcpp::Subscription<sensor_msgs::msg::LaserScan>::SharedPtr scan_sub_;
-	rclcpp::Publisher<geometry_msgs::msg::Twist>::SharedPtr cmd_vel_pub_;
+	rclcpp::Subscription<sensor_msgs::msg::PointCloud2>::SharedPtr cloud_sub_;
+	std::vector<rclcpp::Subscription<sensor_msgs::msg::LaserScan>::SharedPtr> fusion_subs_;
+	rclcpp::CallbackGroup::SharedPtr scan_cb_group_;
+	rclcpp::CallbackGroup::SharedPtr sensor_cb_group_;
+	rclcpp::CallbackGroup::SharedPtr action_cb_group_;
+	rclcpp_lifecycle::LifecyclePublisher<geometry_msgs::msg::Twist>::SharedPtr cmd_vel_pub_;
 	rclcpp::Subscription<sensor_msgs::msg::NavSatFix>::SharedPtr gnss_sub_;
-	rclcpp::Publisher<std_msgs::msg::Bool>::SharedPtr open_place_arrived_pub_;
-	rclcpp::Publisher<std_msgs::msg::String>::SharedPtr open_place_detection_pub_;
+	rclcpp_lifecycle::LifecyclePublisher<std_msgs::msg::Bool>::SharedPtr open_place_arrived_pub_;
+	rclcpp_lifecycle::LifecyclePublisher<std_msgs::msg::String>::SharedPtr open_place_detection_pub_;
 	rclcpp::Subscription<geometry_msgs::msg::PoseWithCovarianceStamped>::SharedPtr gnss_pose_with_covariance_sub_;
 	rclcpp::Subscription<geometry_msgs::msg::PoseStamped>::SharedPtr goal_pose_sub_;
+	rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr odom_sub_;
 
 	rclcpp_action::Server<WallTrackingAction>::SharedPtr wall_tracking_action_srv_;
+	rclcpp::TimerBase::SharedPtr watchdog_timer_;
 
-	geometry_msgs::msg::Twist cmd_vel_msg_;
 	std_msgs::msg::Bool open_place_arrived_msg_; 
 	std_msgs::msg::String open_place_detection_msg_;
+	bool open_place_arrived_published_; //activate後に一度でも出したか
 	nav2_msgs::action::NavigateToPose::Goal nav_goal_msgs_;
 
 	rclcpp_action::Client<NavigateToPose>::SendGoalOptions nav_send_goal_options_;
 	rclcpp_action::Client<NavigateToPose>::SharedPtr navigation_action_client_;
 
+	// goal_workerとアクションのコールバックグループの両方から触る
+	std::mutex behavior_mutex_;
 	std::vector<wall_tracking_msgs::msg::BehaviorStamped> behavior_stamped_array_;
-	rclcpp::Publisher<wall_tracking_msgs::msg::BehaviorStamped>::SharedPtr behavior_stamped_array_pub_;
-
-	float distance_from_wall_;
-	float distance_to_stop_;
-	float max_linear_vel_;
-	float max_angular_vel_, min_angular_vel_;
-	float sampling_rate_;
-	float ei_;
-	float kp_, ki_, kd_;
-	int start_deg_lateral_, end_deg_lateral_;
-	float stop_ray_th_;
-	float wheel_separation_;
-	float distance_to_skip_;
-	float flw_deg_;
-	bool open_place_;
-	float open_place_distance_; 
-	bool outdoor_; //屋外にいるかのフラグ
+	rclcpp_lifecycle::LifecyclePublisher<wall_tracking_msgs::msg::BehaviorStamped>::SharedPtr behavior_stamped_array_pub_;
+	rclcpp_lifecycle::LifecyclePublisher<std_msgs::msg::Float32>::SharedPtr handover_latency_pub_;
+
+	WallFollower follower_; //scanのスレッドでのみ参照する
+	SeqLock<ControlParams> pending_params_;
+	uint32_t applied_params_version_;
+	std::atomic<float> max_linear_vel_, max_angular_vel_, min_angular_vel_;
+	rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr param_callback_handle_;
+	std::atomic<bool> outdoor_; //屋外にいるかのフラグ
 	bool init_scan_data_;
+	bool autostart_;
+	std::atomic<bool> active_;
+	int scan_beam_capacity_;
 	std::shared_ptr<ScanData> scan_data_;
-	float fwc_deg_; //前方の壁との距離をチェックする際に使用するレーザーの開始角度と終了角度
-	float vel_open_place_, cmd_vel_;
-	bool wall_tracking_flg_;
+	CallbackGate scan_gate_; //scan_data_や記録系を使うコールバックの出入り
+	bool cloud_input_;
+	CloudSliceConfig cloud_slice_;
+	CloudProjector cloud_projector_; //cloud_callbackでのみ参照する
+	std::vector<std::string> fusion_scan_topics_;
+	float fusion_max_skew_;
+	ScanFuser scan_fuser_; //fusion_scan_callbackでのみ参照する
+	ScanFeatures scan_features_; //scan_callbackでのみ書き込む
+	SeqLock<ScanFeatures> latest_scan_features_;
+	int64_t turn_hold_until_ns_; //旋回を保つ締め切り。scanのスレッドでのみ参照する
+	std::atomic<bool> wall_tracking_flg_;
 	bool open_place_linear_;
-	std::vector<double> select_angvel_;
-	std::vector<double> detection_div_deg_;
-	float pre_e_;
-	bool gnss_nan_;
-	bool recieved_nav_goal_;
+	std::atomic<bool> gnss_nan_;
+	std::atomic<bool> recieved_nav_goal_;
+	bool deskew_scan_;
+	bool deskew_use_odom_;
+	std::atomic<bool> odom_received_;
+	std::atomic<float> odom_linear_x_, odom_angular_z_;
+	std::atomic<float> last_cmd_linear_x_, last_cmd_angular_z_; //最後に出した指令。deskewや記録が読む
+	bool realtime_mode_;
+	int realtime_cpu_, realtime_priority_;
+	bool realtime_lock_memory_;
+	float scan_deadline_;
+	// 診断のスレッドからも読むのでatomicにする
+	std::atomic<uint64_t> scan_count_, deadline_misses_;
+	float last_scan_duration_, max_scan_duration_;
+	bool scan_latest_only_;
+	float max_scan_age_;
+	std::atomic<uint64_t> dropped_scans_, late_scans_, lost_scans_;
+	float scan_timeout_, scan_gap_factor_, watchdog_period_;
+	std::unique_ptr<ScanWatchdog> scan_watchdog_;
+	float last_scan_age_;
+	std::unique_ptr<diagnostic_updater::Updater> diagnostic_updater_;
+	DurationHistogram callback_durations_;
+	float callback_budget_;
+	float scan_rate_warn_ratio_, scan_rate_error_ratio_;
+	int behavior_log_warn_size_;
+	std::atomic<std::size_t> behavior_log_size_;
+	bool load_governor_enabled_;
+	GovernorConfig governor_config_;
+	int governor_sector_limit_;
+	LoadGovernor load_governor_; //scanのスレッドでのみ参照する
+	std::atomic<uint8_t> load_level_;
+	std::atomic<uint64_t> load_level_changes_;
+	std::chrono::steady_clock::time_point last_diagnose_time_;
+	uint64_t diag_scan_count_, diag_dropped_scans_, diag_late_scans_, diag_lost_scans_, diag_deadline_misses_;
+	std::string flight_recorder_path_;
+	int flight_recorder_slots_;
+	bool flight_recorder_ranges_;
+	FlightRecorder flight_recorder_;
+	FlightRecord flight_record_; //scanのスレッドでのみ書き込む
+	std::string decision_trace_path_;
+	int decision_trace_queue_;
+	DecisionTraceWriter decision_trace_;
+	float nav_cancel_timeout_;
+	std::atomic<float> last_handover_latency_;
+	// 実行中のゴールは常に1つで、新しいゴールが来たら古いゴールを中断する
+	std::thread goal_worker_thread_;
+	std::mutex goal_mutex_;
+	std::condition_variable goal_cv_;
+	std::shared_ptr<GoalHandleWallTracking> pending_goal_;
+	std::atomic<bool> preempt_requested_;
+	std::atomic<bool> goal_active_;
+	std::atomic<bool> goal_worker_stop_;
+	std::string executor_type_;
+	int executor_threads_;
 };
 
 } // namespace WallTracking
@@ -0,0 +1,269 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+// Sweeps control parameters over the simulator. Every configuration runs the
+// same set of jittered episodes; all (configuration, episode) pairs go into
+// one job list that the worker threads drain, so slow configurations do not
+// leave cores idle. Output is one CSV line per configuration on stdout and the
+// fastest stable configurations on stderr.
+//
+// usage: wall_tracking_sweep [--params yaml] [--world corridor|loop|file] [--episodes n]
+//                            [--threads n] [--duration sec] [--mission m] [--beams n]
+//                            [--noise m] [--seed n] [--random n] [--top n]
+//                            --grid name=v1,v2,.. | --grid name=min:max:step ...
+//
+// name is one of kp, ki, kd, start_deg_lateral, end_deg_lateral, max_linear_vel,
+// max_angular_vel, distance_from_wall, distance_to_skip, stop_ray_th, select_angvel_scale.
+// With --random n, n configurations are drawn uniformly between each grid's min and max.
+
+#include "wall_tracking_executor/Simulator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace WallTracking;
+
+namespace {
+struct Dimension
+{
+    std::string name;
+    std::vector<float> values;
+};
+
+struct SweepConfig
+{
+    std::string params = "config/wall_tracking_executor.param.yaml";
+    std::string world = "loop";
+    int episodes = 8;
+    std::size_t threads = 0;
+    float duration = 600.;
+    float mission_distance = 60.;
+    int beams = 720;
+    float noise = 0.01;
+    std::uint32_t seed = 1;
+    int random = 0;
+    int top = 5;
+    std::vector<Dimension> dims;
+};
+
+struct Summary
+{
+    std::vector<float> values;
+    bool valid = true;
+    int collisions = 0, completed = 0;
+    float mission_time = 0., rms_wall_error = 0., max_wall_error = 0.;
+    bool stable() const { return valid && collisions == 0 && completed > 0; }
+};
+
+bool parseDimension(const std::string &spec, Dimension &dim)
+{
+    std::size_t eq = spec.find('=');
+    if (eq == std::string::npos) return false;
+    dim.name = spec.substr(0, eq);
+    std::string v = spec.substr(eq + 1);
+    if (std::count(v.begin(), v.end(), ':') == 2) {
+        std::replace(v.begin(), v.end(), ':', ' ');
+        std::istringstream ss(v);
+        float lo, hi, step;
+        if (!(ss >> lo >> hi >> step) || step <= 0. || hi < lo) return false;
+        for (int i = 0; lo + i * step <= hi + 1e-6f; ++i) dim.values.push_back(lo + i * step);
+    } else {
+        std::replace(v.begin(), v.end(), ',', ' ');
+        std::istringstream ss(v);
+        float x;
+        while (ss >> x) dim.values.push_back(x);
+    }
+    return !dim.values.empty();
+}
+
+SweepConfig parseArgs(int argc, char *argv[])
+{
+    SweepConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--params" && has_value) config.params = argv[++i];
+        else if (a == "--world" && has_value) config.world = argv[++i];
+        else if (a == "--episodes" && has_value) config.episodes = std::stoi(argv[++i]);
+        else if (a == "--threads" && has_value) config.threads = std::stoul(argv[++i]);
+        else if (a == "--duration" && has_value) config.duration = std::stof(argv[++i]);
+        else if (a == "--mission" && has_value) config.mission_distance = std::stof(argv[++i]);
+        else if (a == "--beams" && has_value) config.beams = std::stoi(argv[++i]);
+        else if (a == "--noise" && has_value) config.noise = std::stof(argv[++i]);
+        else if (a == "--seed" && has_value) config.seed = std::stoul(argv[++i]);
+        else if (a == "--random" && has_value) config.random = std::stoi(argv[++i]);
+        else if (a == "--top" && has_value) config.top = std::stoi(argv[++i]);
+        else if (a == "--grid" && has_value) {
+            Dimension dim;
+            if (parseDimension(argv[++i], dim)) config.dims.push_back(dim);
+            else std::cerr << "ignoring invalid grid: " << argv[i] << std::endl;
+        }
+        else std::cerr << "ignoring unknown argument: " << a << std::endl;
+    }
+    return config;
+}
+
+bool setParam(ControlParams &p, const std::string &name, float value)
+{
+    if (name == "kp") p.kp = value;
+    else if (name == "ki") p.ki = value;
+    else if (name == "kd") p.kd = value;
+    else if (name == "start_deg_lateral") p.start_deg_lateral = static_cast<int>(std::lround(value));
+    else if (name == "end_deg_lateral") p.end_deg_lateral = static_cast<int>(std::lround(value));
+    else if (name == "max_linear_vel") p.max_linear_vel = value;
+    else if (name == "max_angular_vel") {
+        p.max_angular_vel = value;
+        p.min_angular_vel = -value;
+    }
+    else if (name == "distance_from_wall") p.distance_from_wall = value;
+    else if (name == "distance_to_skip") p.distance_to_skip = value;
+    else if (name == "stop_ray_th") p.stop_ray_th = value;
+    else if (name == "select_angvel_scale") {
+        for (int i = 0; i < p.sector_num; ++i) p.select_angvel[i] *= value;
+    }
+    else return false;
+    return true;
+}
+
+std::vector<std::vector<float>> makeCandidates(const SweepConfig &config)
+{
+    std::vector<std::vector<float>> candidates;
+    if (config.random > 0) {
+        std::mt19937 rng(config.seed);
+        for (int n = 0; n < config.random; ++n) {
+            std::vector<float> c;
+            for (const auto &dim : config.dims) {
+                auto range = std::minmax_element(dim.values.begin(), dim.values.end());
+                c.push_back(std::uniform_real_distribution<float>(*range.first, *range.second)(rng));
+            }
+            candidates.push_back(c);
+        }
+        return candidates;
+    }
+    // 全次元の直積を作る
+    candidates.emplace_back();
+    for (const auto &dim : config.dims) {
+        std::vector<std::vector<float>> next;
+        for (const auto &c : candidates) {
+            for (float v : dim.values) {
+                next.push_back(c);
+                next.back().push_back(v);
+            }
+        }
+        candidates.swap(next);
+    }
+    return candidates;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    SweepConfig config = parseArgs(argc, argv);
+    std::string err;
+    ControlParams base;
+    if (!loadControlParams(config.params, base, err)) {
+        std::cerr << "failed to load parameters: " << err << std::endl;
+        return 1;
+    }
+    for (const auto &dim : config.dims) {
+        ControlParams probe = base;
+        if (!setParam(probe, dim.name, dim.values[0])) {
+            std::cerr << "unknown parameter: " << dim.name << std::endl;
+            return 1;
+        }
+    }
+    World world;
+    Pose2D start;
+    if (!makeWorld(config.world, base.distance_from_wall, world, start, err)) {
+        std::cerr << "failed to load world: " << err << std::endl;
+        return 1;
+    }
+
+    std::vector<std::vector<float>> candidates = makeCandidates(config);
+    std::vector<Summary> summaries(candidates.size());
+    std::vector<EpisodeConfig> jobs;
+    std::vector<std::size_t> owner;
+    const std::size_t episodes = static_cast<std::size_t>(std::max(config.episodes, 1));
+    for (std::size_t c = 0; c < candidates.size(); ++c) {
+        ControlParams params = base;
+        for (std::size_t d = 0; d < config.dims.size(); ++d) setParam(params, config.dims[d].name, candidates[c][d]);
+        summaries[c].values = candidates[c];
+        // start_deg_lateral > end_deg_lateralなどの組み合わせは走らせない
+        std::string reason;
+        if (!computeDerived(params, reason)) {
+            summaries[c].valid = false;
+            continue;
+        }
+        // どの設定も同じ初期姿勢とノイズ列で比較する
+        std::mt19937 rng(config.seed);
+        std::uniform_real_distribution<float> jitter_xy(-0.1, 0.1), jitter_yaw(-0.1, 0.1);
+        for (std::size_t e = 0; e < episodes; ++e) {
+            EpisodeConfig job;
+            job.world = &world;
+            job.params = params;
+            job.lidar.beams = config.beams;
+            job.lidar.noise_stddev = config.noise;
+            job.start = start;
+            job.start.y += jitter_xy(rng);
+            job.start.yaw += jitter_yaw(rng);
+            job.duration = config.duration;
+            job.mission_distance = config.mission_distance;
+            job.seed = rng();
+            jobs.push_back(job);
+            owner.push_back(c);
+        }
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<EpisodeResult> results = runEpisodes(jobs, config.threads);
+    double wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::vector<double> err2(summaries.size(), 0.);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const EpisodeResult &r = results[i];
+        Summary &s = summaries[owner[i]];
+        s.collisions += r.collided;
+        s.completed += r.completed;
+        s.mission_time += r.sim_time / static_cast<float>(episodes);
+        s.max_wall_error = std::max(s.max_wall_error, r.max_wall_error);
+        err2[owner[i]] += r.rms_wall_error * r.rms_wall_error / static_cast<double>(episodes);
+    }
+    for (std::size_t c = 0; c < summaries.size(); ++c) summaries[c].rms_wall_error = std::sqrt(err2[c]);
+
+    for (const auto &dim : config.dims) std::printf("%s,", dim.name.c_str());
+    std::printf("valid,episodes,collisions,completed,mission_time,rms_wall_error,max_wall_error\n");
+    for (const auto &s : summaries) {
+        for (float v : s.values) std::printf("%g,", v);
+        std::printf("%d,%zu,%d,%d,%.2f,%.3f,%.3f\n", s.valid, episodes, s.collisions, s.completed,
+            s.mission_time, s.rms_wall_error, s.max_wall_error);
+    }
+
+    // 衝突がなく全エピソードで走り切った設定を、ミッション時間、壁との誤差の順に並べる
+    std::vector<std::size_t> order(summaries.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        const Summary &sa = summaries[a], &sb = summaries[b];
+        bool full_a = sa.stable() && sa.completed == static_cast<int>(episodes);
+        bool full_b = sb.stable() && sb.completed == static_cast<int>(episodes);
+        if (full_a != full_b) return full_a;
+        if (sa.mission_time != sb.mission_time) return sa.mission_time < sb.mission_time;
+        return sa.rms_wall_error < sb.rms_wall_error;
+    });
+    std::fprintf(stderr, "%zu configurations x %zu episodes in %.2f s\n", summaries.size(), episodes, wall_sec);
+    for (int k = 0; k < config.top && k < static_cast<int>(order.size()); ++k) {
+        const Summary &s = summaries[order[k]];
+        if (!(s.stable() && s.completed == static_cast<int>(episodes))) break;
+        std::fprintf(stderr, "#%d", k + 1);
+        for (std::size_t d = 0; d < config.dims.size(); ++d) std::fprintf(stderr, " %s=%g", config.dims[d].name.c_str(), s.values[d]);
+        std::fprintf(stderr, ": mission %.2f s, rms %.3f m, max %.3f m\n", s.mission_time, s.rms_wall_error, s.max_wall_error);
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/CloudProjector.hpp>
+#include <wall_tracking_executor/FastMath.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace WallTracking{
+CloudProjector::CloudProjector()
+: size_(0), points_in_slice_(0)
+{
+}
+
+bool CloudProjector::configure(const CloudSliceConfig &config, std::string &err)
+{
+    if (!(config.min_height < config.max_height)) {
+        err = "cloud_min_height must be smaller than cloud_max_height";
+        return false;
+    }
+    if (!(config.angle_increment_deg > 0.) || !(config.angle_min_deg < config.angle_max_deg)) {
+        err = "cloud angle range must be increasing with a positive increment";
+        return false;
+    }
+    if (!(config.range_min >= 0.) || !(config.range_min < config.range_max)) {
+        err = "cloud_range_min must be in [0, cloud_range_max)";
+        return false;
+    }
+    config_ = config;
+    size_ = static_cast<std::size_t>(
+        std::ceil((config.angle_max_deg - config.angle_min_deg) / config.angle_increment_deg));
+    geometry_.angle_min = DEG2RAD(config.angle_min_deg);
+    geometry_.angle_increment = DEG2RAD(config.angle_increment_deg);
+    geometry_.angle_max = geometry_.angle_min + geometry_.angle_increment * static_cast<float>(size_ - 1);
+    // 点群は時刻順に並んでいないのでdeskewは行わない
+    geometry_.time_increment = 0.;
+    geometry_.range_min = config.range_min;
+    geometry_.range_max = config.range_max;
+    bins_.assign(size_ + 1, std::numeric_limits<float>::infinity());
+    return true;
+}
+
+void CloudProjector::projectChunk(const float *x, const float *y, const float *z, std::size_t n)
+{
+    const float min_h = config_.min_height, max_h = config_.max_height;
+    const float r2_min = config_.range_min * config_.range_min;
+    const float r2_max = config_.range_max * config_.range_max;
+    const float angle_min = geometry_.angle_min, inv_inc = 1.f / geometry_.angle_increment;
+    const int sink = static_cast<int>(size_);
+    float range[kChunk];
+    int bin[kChunk];
+    unsigned in_slice = 0;
+    // 分岐なしにしてベクトル化させる。atan2はlibmを呼ぶとベクトル化されないので近似を使い、
+    // sqrtのerrno分岐はCMakeLists.txtの-fno-math-errnoで消している。負のbは無効なのでfloorでなく切り捨てでよい。
+    // スライス外やNaNの点は捨て場のビンに送る
+    for (std::size_t i = 0; i < n; ++i) {
+        float r2 = x[i] * x[i] + y[i] * y[i];
+        float b = (atan2Approx(y[i], x[i]) - angle_min) * inv_inc;
+        bool valid = (z[i] >= min_h) & (z[i] <= max_h) & (r2 >= r2_min) & (r2 <= r2_max) &
+            (b >= 0.f) & (b < static_cast<float>(sink));
+        bin[i] = static_cast<int>(valid ? b : static_cast<float>(sink));
+        range[i] = std::sqrt(r2);
+        in_slice += valid;
+    }
+    // 同じビンに複数の点が落ちうるので最小値の書き戻しはスカラーのまま
+    float *bins = bins_.data();
+    for (std::size_t i = 0; i < n; ++i) bins[bin[i]] = std::min(bins[bin[i]], range[i]);
+    points_in_slice_ += in_slice;
+}
+
+bool CloudProjector::project(const CloudLayout &cloud)
+{
+    std::fill(bins_.begin(), bins_.end(), std::numeric_limits<float>::infinity());
+    points_in_slice_ = 0;
+    if (cloud.width == 0 || cloud.height == 0) return true;
+    std::size_t field_end = std::max({cloud.x_offset, cloud.y_offset, cloud.z_offset}) + sizeof(float);
+    if (cloud.data == nullptr || cloud.point_step < field_end ||
+        cloud.row_step < cloud.width * cloud.point_step) return false;
+    float x[kChunk], y[kChunk], z[kChunk];
+    for (std::size_t row = 0; row < cloud.height; ++row) {
+        const std::uint8_t *p = cloud.data + row * cloud.row_step;
+        for (std::size_t begin = 0; begin < cloud.width; begin += kChunk) {
+            std::size_t n = std::min(kChunk, cloud.width - begin);
+            // フィールドはアラインされていない可能性があるのでmemcpyで読む
+            for (std::size_t i = 0; i < n; ++i, p += cloud.point_step) {
+                std::memcpy(&x[i], p + cloud.x_offset, sizeof(float));
+                std::memcpy(&y[i], p + cloud.y_offset, sizeof(float));
+                std::memcpy(&z[i], p + cloud.z_offset, sizeof(float));
+            }
+            projectChunk(x, y, z, n);
+        }
+    }
+    return true;
+}
+} // namespace WallTracking
@@ -0,0 +1,40 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/ControlParams.hpp>
+#include <wall_tracking_executor/ScanData.hpp>
+
+#include <cmath>
+
+namespace WallTracking{
+bool computeDerived(ControlParams &p, std::string &err)
+{
+    if (p.sampling_rate <= 0.) {
+        err = "sampling_rate must be positive";
+        return false;
+    }
+    if (p.distance_from_wall <= 0. || p.distance_to_stop <= 0.) {
+        err = "distance_from_wall and distance_to_stop must be positive";
+        return false;
+    }
+    if (p.start_deg_lateral <= 0 || p.start_deg_lateral > p.end_deg_lateral || p.end_deg_lateral > 180) {
+        err = "lateral range must satisfy 0 < start_deg_lateral <= end_deg_lateral <= 180";
+        return false;
+    }
+    if (p.min_angular_vel > p.max_angular_vel) {
+        err = "min_angular_vel must not exceed max_angular_vel";
+        return false;
+    }
+    if (p.sector_num < 0 || p.sector_num > ControlParams::kMaxSectors) {
+        err = "detection_div_deg must hold at most " + std::to_string(ControlParams::kMaxSectors) +
+            " sectors with one select_angvel each";
+        return false;
+    }
+    p.fwc_deg = RAD2DEG(atan2f(-p.wheel_separation / 2, p.distance_to_stop));
+    float y = p.distance_from_wall, x = p.distance_to_skip;
+    x += p.distance_from_wall / tan(DEG2RAD(p.start_deg_lateral));
+    p.flw_deg = RAD2DEG(atan2(y, x));
+    p.vel_open_place = p.max_linear_vel / 3;
+    return true;
+}
+} // namespace WallTracking
@@ -0,0 +1,193 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/DecisionTrace.hpp>
+#include <wall_tracking_executor/FileRotation.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+namespace WallTracking{
+namespace {
+constexpr char kMagic[8] = {'W', 'T', 'T', 'R', 'A', 'C', 'E', '1'};
+
+struct FileHeader
+{
+    char magic[8];
+    std::uint32_t record_size;
+    std::uint32_t max_sectors;
+};
+
+static_assert(std::is_trivially_copyable<TraceRecord>::value, "TraceRecord is written as raw bytes");
+static_assert(sizeof(TraceRecord) == 8 + 8 + 4 + 9 * 4 + 2 * 4 * (ControlParams::kMaxSectors + 1),
+    "TraceRecord must not contain padding");
+
+bool validHeader(const FileHeader &h)
+{
+    return std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.record_size == sizeof(TraceRecord) &&
+        h.max_sectors == ControlParams::kMaxSectors;
+}
+
+// 既存のファイルを追記できる状態にする。途中で切れた末尾のレコードは捨て、
+// レイアウトが違うファイルは別名に退避する。next_seqには続きの番号が入る
+bool prepareAppend(const std::string &path, std::uint64_t &next_seq, std::string &moved_to, std::string &err)
+{
+    next_seq = 0;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || st.st_size == 0) return true;
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    FileHeader header;
+    bool valid = std::fread(&header, sizeof(header), 1, file) == 1 && validHeader(header);
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    std::size_t count = valid ? (size - sizeof(FileHeader)) / sizeof(TraceRecord) : 0;
+    TraceRecord last;
+    if (valid && count > 0) {
+        valid = std::fseek(file, static_cast<long>(sizeof(FileHeader) + (count - 1) * sizeof(TraceRecord)), SEEK_SET) == 0 &&
+            std::fread(&last, sizeof(last), 1, file) == 1;
+        if (valid) next_seq = last.seq + 1;
+    }
+    std::fclose(file);
+    if (!valid) return moveAside(path, moved_to, err);
+    std::size_t keep = sizeof(FileHeader) + count * sizeof(TraceRecord);
+    if (keep != size && truncate(path.c_str(), static_cast<off_t>(keep)) != 0) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+TraceRecord toTraceRecord(std::int64_t stamp_ns, const Decision &decision)
+{
+    TraceRecord r;
+    r.stamp_ns = stamp_ns;
+    r.action = static_cast<std::uint8_t>(decision.action);
+    r.flags = (decision.open_place ? TraceRecord::OPEN_PLACE : 0) |
+        (decision.gap_start ? TraceRecord::GAP_START : 0) |
+        (decision.gap_end ? TraceRecord::GAP_END : 0) |
+        (decision.front_left_wall ? TraceRecord::FRONT_LEFT_WALL : 0);
+    r.sector_num = static_cast<std::int8_t>(decision.sector_num);
+    r.max_index = static_cast<std::int8_t>(decision.max_index);
+    r.linear_x = decision.linear_x;
+    r.angular_z = decision.angular_z;
+    r.open_place_ratio = decision.open_place_ratio;
+    r.open_place_mean = decision.open_place_mean;
+    r.front_wall_ratio = decision.front_wall_ratio;
+    r.lateral_mean = decision.lateral_mean;
+    r.pid_p = decision.pid_p;
+    r.pid_i = decision.pid_i;
+    r.pid_d = decision.pid_d;
+    std::copy(std::begin(decision.evals), std::end(decision.evals), r.evals);
+    std::copy(std::begin(decision.means), std::end(decision.means), r.means);
+    return r;
+}
+
+DecisionTraceWriter::DecisionTraceWriter()
+: file_(nullptr), stop_(false), seq_(0), written_(0), dropped_(0)
+{
+}
+
+DecisionTraceWriter::~DecisionTraceWriter()
+{
+    close();
+}
+
+bool DecisionTraceWriter::open(const std::string &path, std::size_t queue_capacity, std::string &err)
+{
+    close();
+    moved_to_.clear();
+    std::uint64_t next_seq;
+    if (!prepareAppend(path, next_seq, moved_to_, err)) return false;
+    file_ = std::fopen(path.c_str(), "ab");
+    if (file_ == nullptr) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fileno(file_), &st) == 0 && st.st_size == 0) {
+        FileHeader header;
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.record_size = sizeof(TraceRecord);
+        header.max_sectors = ControlParams::kMaxSectors;
+        std::fwrite(&header, sizeof(header), 1, file_);
+    }
+    queue_ = std::make_unique<SpscQueue<TraceRecord>>(std::max<std::size_t>(queue_capacity, 2));
+    stop_ = false;
+    seq_ = next_seq;
+    written_ = 0;
+    dropped_ = 0;
+    thread_ = std::thread(&DecisionTraceWriter::run, this);
+    return true;
+}
+
+void DecisionTraceWriter::close()
+{
+    if (file_ == nullptr) return;
+    stop_ = true;
+    if (thread_.joinable()) thread_.join();
+    std::fclose(file_);
+    file_ = nullptr;
+    queue_.reset();
+}
+
+void DecisionTraceWriter::push(const TraceRecord &record)
+{
+    if (file_ == nullptr) return;
+    TraceRecord r = record;
+    r.seq = seq_++;
+    if (!queue_->push(r)) ++dropped_;
+}
+
+void DecisionTraceWriter::run()
+{
+    // 書き込み側はpushで起こさず、一定周期でまとめてfwriteする
+    constexpr std::size_t kBatch = 256;
+    std::vector<TraceRecord> batch(kBatch);
+    while (true) {
+        bool stopping = stop_;
+        std::size_t n = 0;
+        while (n < kBatch && queue_->pop(batch[n])) ++n;
+        if (n > 0) {
+            std::fwrite(batch.data(), sizeof(TraceRecord), n, file_);
+            written_ += n;
+        }
+        if (n == kBatch) continue;
+        if (stopping) break;
+        std::fflush(file_);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    std::fflush(file_);
+}
+
+bool readDecisionTrace(const std::string &path, std::vector<TraceRecord> &records, std::string &err)
+{
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    FileHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.record_size != sizeof(TraceRecord) || header.max_sectors != ControlParams::kMaxSectors) {
+        err = path + ": not a decision trace of this version";
+        std::fclose(file);
+        return false;
+    }
+    records.clear();
+    TraceRecord r;
+    // 書き込み途中で切れた末尾のレコードは読まない
+    while (std::fread(&r, sizeof(r), 1, file) == 1) records.push_back(r);
+    std::fclose(file);
+    return true;
+}
+} // namespace WallTracking
@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/DurationHistogram.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace WallTracking{
+DurationHistogram::DurationHistogram()
+: max_(0.)
+{
+    for (auto &c : counts_) c.store(0, std::memory_order_relaxed);
+}
+
+void DurationHistogram::record(float seconds)
+{
+    float us = seconds * 1e6f;
+    int bucket = us > 1.f ? static_cast<int>(std::ceil(4.f * std::log2(us))) : 0;
+    bucket = std::min(std::max(bucket, 0), kBuckets - 1);
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+    if (seconds > max_.load(std::memory_order_relaxed)) max_.store(seconds, std::memory_order_relaxed);
+}
+
+DurationSummary DurationHistogram::takeSummary()
+{
+    std::array<std::uint32_t, kBuckets> counts;
+    DurationSummary s;
+    for (int i = 0; i < kBuckets; ++i) {
+        counts[i] = counts_[i].exchange(0, std::memory_order_relaxed);
+        s.count += counts[i];
+    }
+    s.max = max_.exchange(0., std::memory_order_relaxed);
+    if (s.count == 0) return s;
+    // 各パーセンタイルに届いたバケットの上端を返す
+    const double ranks[3] = {0.5, 0.9, 0.99};
+    float *out[3] = {&s.p50, &s.p90, &s.p99};
+    std::uint64_t seen = 0;
+    int k = 0;
+    for (int i = 0; i < kBuckets && k < 3; ++i) {
+        seen += counts[i];
+        while (k < 3 && static_cast<double>(seen) >= ranks[k] * static_cast<double>(s.count)) {
+            *out[k++] = std::min(bucketUpperEdge(i), s.max > 0. ? s.max : bucketUpperEdge(i));
+        }
+    }
+    return s;
+}
+
+float DurationHistogram::bucketUpperEdge(int bucket)
+{
+    return std::exp2(static_cast<float>(bucket) / 4.f) * 1e-6f;
+}
+} // namespace WallTracking
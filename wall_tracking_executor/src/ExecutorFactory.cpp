@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/ExecutorFactory.hpp>
+
+#include <stdexcept>
+
+#if __has_include(<rclcpp/experimental/executors/events_executor/events_executor.hpp>)
+#include <rclcpp/experimental/executors/events_executor/events_executor.hpp>
+#define WALL_TRACKING_HAS_EVENTS_EXECUTOR 1
+#else
+#define WALL_TRACKING_HAS_EVENTS_EXECUTOR 0
+#endif
+
+namespace WallTracking{
+rclcpp::Executor::SharedPtr createExecutor(const std::string &type, std::size_t threads)
+{
+    if (type == "single_threaded") {
+        return std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+    } else if (type == "multi_threaded") {
+        return std::make_shared<rclcpp::executors::MultiThreadedExecutor>(
+            rclcpp::ExecutorOptions(), threads);
+    } else if (type == "static_single_threaded") {
+        return std::make_shared<rclcpp::executors::StaticSingleThreadedExecutor>();
+    } else if (type == "events") {
+#if WALL_TRACKING_HAS_EVENTS_EXECUTOR
+        return std::make_shared<rclcpp::experimental::executors::EventsExecutor>();
+#else
+        throw std::invalid_argument("events executor is not available in this rclcpp");
+#endif
+    }
+    throw std::invalid_argument("unknown executor type: " + type);
+}
+
+std::vector<std::string> availableExecutorTypes()
+{
+    std::vector<std::string> types{"single_threaded", "multi_threaded", "static_single_threaded"};
+#if WALL_TRACKING_HAS_EVENTS_EXECUTOR
+    types.push_back("events");
+#endif
+    return types;
+}
+} // namespace WallTracking
@@ -0,0 +1,215 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/FlightRecorder.hpp>
+#include <wall_tracking_executor/FileRotation.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+namespace WallTracking{
+namespace {
+constexpr char kMagic[8] = {'W', 'T', 'F', 'R', 'E', 'C', '0', '1'};
+constexpr std::size_t kHeaderSize = 4096;
+
+struct FileHeader
+{
+    char magic[8];
+    std::uint32_t record_size; //FlightRecordのサイズ、レイアウトの確認に使う
+    std::uint32_t slot_size;
+    std::uint64_t slot_count;
+    std::uint64_t max_ranges;
+    std::uint64_t next_seq;
+};
+
+static_assert(std::is_trivially_copyable<FlightRecord>::value, "FlightRecord is stored as raw bytes");
+static_assert(sizeof(FileHeader) <= kHeaderSize, "header must fit in its page");
+
+std::size_t slotSize(std::size_t max_ranges)
+{
+    std::size_t size = sizeof(FlightRecord) + max_ranges * sizeof(float);
+    return (size + 63) / 64 * 64;
+}
+
+bool validHeader(const FileHeader &h)
+{
+    return std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.record_size == sizeof(FlightRecord) &&
+        h.slot_size == slotSize(h.max_ranges) && h.slot_count > 0;
+}
+} // namespace
+
+FlightRecorder::FlightRecorder()
+: fd_(-1), map_(nullptr), map_size_(0), slots_(nullptr),
+  slot_size_(0), slot_count_(0), max_ranges_(0)
+{
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    close();
+}
+
+bool FlightRecorder::open(const std::string &path, std::size_t slot_count, std::size_t max_ranges, std::string &err)
+{
+    close();
+    moved_to_.clear();
+    if (slot_count == 0) {
+        err = "slot_count must be positive";
+        return false;
+    }
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    slot_size_ = slotSize(max_ranges);
+    slot_count_ = slot_count;
+    max_ranges_ = max_ranges;
+    map_size_ = kHeaderSize + slot_size_ * slot_count_;
+    struct stat st;
+    if (fstat(fd_, &st) != 0) st.st_size = 0;
+    bool reuse = false;
+    if (static_cast<std::size_t>(st.st_size) == map_size_) {
+        FileHeader existing;
+        reuse = pread(fd_, &existing, sizeof(existing), 0) == static_cast<ssize_t>(sizeof(existing)) &&
+            validHeader(existing) && existing.slot_count == slot_count_ && existing.max_ranges == max_ranges_;
+    }
+    if (!reuse && st.st_size > 0) {
+        // 前回の記録はレイアウトが違っても消さずに別名で残し、新しいファイルを作る
+        ::close(fd_);
+        fd_ = -1;
+        if (!moveAside(path, moved_to_, err)) return false;
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            err = path + ": " + std::strerror(errno);
+            return false;
+        }
+    }
+    if (!reuse && ftruncate(fd_, static_cast<off_t>(map_size_)) != 0) {
+        err = path + ": " + std::strerror(errno);
+        close();
+        return false;
+    }
+    void *map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+        err = path + ": " + std::strerror(errno);
+        map_ = nullptr;
+        close();
+        return false;
+    }
+    map_ = static_cast<std::uint8_t *>(map);
+    slots_ = map_ + kHeaderSize;
+    if (!reuse) {
+        FileHeader *header = reinterpret_cast<FileHeader *>(map_);
+        std::memcpy(header->magic, kMagic, sizeof(kMagic));
+        header->record_size = sizeof(FlightRecord);
+        header->slot_size = static_cast<std::uint32_t>(slot_size_);
+        header->slot_count = slot_count_;
+        header->max_ranges = max_ranges_;
+        __atomic_store_n(&header->next_seq, 1, __ATOMIC_RELEASE);
+    }
+    // 記録中にページフォルトが起きないよう、全ページを書き込み可能な状態で先に割り当てておく
+    long page = sysconf(_SC_PAGESIZE);
+    for (std::size_t off = 0; off < map_size_; off += static_cast<std::size_t>(page)) {
+        volatile std::uint8_t *p = map_ + off;
+        *p = *p;
+    }
+    return true;
+}
+
+void FlightRecorder::close()
+{
+    if (map_ != nullptr) {
+        msync(map_, map_size_, MS_ASYNC);
+        munmap(map_, map_size_);
+    }
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    map_ = nullptr;
+    slots_ = nullptr;
+}
+
+void FlightRecorder::record(const FlightRecord &record, RangeView ranges)
+{
+    if (map_ == nullptr) return;
+    FileHeader *header = reinterpret_cast<FileHeader *>(map_);
+    std::uint64_t seq = __atomic_load_n(&header->next_seq, __ATOMIC_RELAXED);
+    std::uint8_t *slot = slots_ + ((seq - 1) % slot_count_) * slot_size_;
+    FlightRecord *dst = reinterpret_cast<FlightRecord *>(slot);
+    // 書き込み途中で落ちてもそのスロットは読まれないよう、先にseqを0にする
+    __atomic_store_n(&dst->seq, 0, __ATOMIC_RELEASE);
+    std::size_t n = std::min(ranges.size(), max_ranges_);
+    FlightRecord tmp = record;
+    tmp.seq = 0;
+    tmp.range_count = static_cast<std::uint16_t>(std::min<std::size_t>(n, UINT16_MAX));
+    std::memcpy(slot, &tmp, sizeof(FlightRecord));
+    if (n > 0) std::memcpy(slot + sizeof(FlightRecord), ranges.data(), n * sizeof(float));
+    __atomic_store_n(&dst->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->next_seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+std::uint64_t FlightRecorder::recorded() const
+{
+    if (map_ == nullptr) return 0;
+    return __atomic_load_n(&reinterpret_cast<FileHeader *>(map_)->next_seq, __ATOMIC_ACQUIRE) - 1;
+}
+
+bool readFlightRecords(const std::string &path, std::vector<FlightRecord> &records,
+    std::vector<float> *ranges, std::size_t &max_ranges, std::string &err)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    FileHeader h;
+    bool ok = fstat(fd, &st) == 0 && pread(fd, &h, sizeof(h), 0) == static_cast<ssize_t>(sizeof(h)) &&
+        validHeader(h) && static_cast<std::uint64_t>(st.st_size) == kHeaderSize + h.slot_size * h.slot_count;
+    if (!ok) {
+        err = path + ": not a flight recorder file of this version";
+        ::close(fd);
+        return false;
+    }
+    const std::size_t slot_size = h.slot_size, slot_count = h.slot_count;
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    const std::uint8_t *slots = static_cast<const std::uint8_t *>(map) + kHeaderSize;
+    std::vector<std::size_t> order;
+    records.clear();
+    for (std::size_t i = 0; i < slot_count; ++i) {
+        FlightRecord r;
+        std::memcpy(&r, slots + i * slot_size, sizeof(r));
+        if (r.seq == 0) continue;
+        records.push_back(r);
+        order.push_back(i);
+    }
+    std::vector<std::size_t> idx(records.size());
+    for (std::size_t i = 0; i < idx.size(); ++i) idx[i] = i;
+    std::sort(idx.begin(), idx.end(), [&](std::size_t a, std::size_t b) { return records[a].seq < records[b].seq; });
+    std::vector<FlightRecord> sorted;
+    sorted.reserve(records.size());
+    max_ranges = h.max_ranges;
+    if (ranges) ranges->assign(records.size() * max_ranges, 0.f);
+    for (std::size_t k = 0; k < idx.size(); ++k) {
+        sorted.push_back(records[idx[k]]);
+        if (ranges && max_ranges > 0) {
+            std::memcpy(ranges->data() + k * max_ranges, slots + order[idx[k]] * slot_size + sizeof(FlightRecord),
+                max_ranges * sizeof(float));
+        }
+    }
+    records.swap(sorted);
+    munmap(map, st.st_size);
+    return true;
+}
+} // namespace WallTracking
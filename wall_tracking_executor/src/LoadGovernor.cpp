@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/LoadGovernor.hpp>
+
+namespace WallTracking{
+namespace {
+constexpr float kAlpha = 0.2; //処理時間の指数移動平均の重み
+} // namespace
+
+const char *toString(LoadLevel level)
+{
+    switch (level) {
+    case LoadLevel::FULL: return "full";
+    case LoadLevel::NO_DEBUG: return "no debug output";
+    case LoadLevel::NO_DESKEW: return "no debug output, no deskew";
+    case LoadLevel::REDUCED_SECTORS: return "no debug output, no deskew, reduced sectors";
+    }
+    return "unknown";
+}
+
+LoadGovernor::LoadGovernor()
+{
+    reset();
+}
+
+void LoadGovernor::configure(const GovernorConfig &config)
+{
+    config_ = config;
+    reset();
+}
+
+void LoadGovernor::reset()
+{
+    level_ = LoadLevel::FULL;
+    mean_duration_ = 0.;
+    over_scans_ = 0;
+    under_scans_ = 0;
+}
+
+bool LoadGovernor::update(float duration)
+{
+    if (config_.budget <= 0.) return false;
+    mean_duration_ = mean_duration_ == 0. ? duration : mean_duration_ + kAlpha * (duration - mean_duration_);
+    over_scans_ = mean_duration_ > config_.budget * config_.degrade_ratio ? over_scans_ + 1 : 0;
+    under_scans_ = mean_duration_ < config_.budget * config_.recover_ratio ? under_scans_ + 1 : 0;
+    if (over_scans_ >= config_.degrade_scans && level_ != LoadLevel::REDUCED_SECTORS) {
+        level_ = static_cast<LoadLevel>(static_cast<int>(level_) + 1);
+    } else if (under_scans_ >= config_.recover_scans && level_ != LoadLevel::FULL) {
+        level_ = static_cast<LoadLevel>(static_cast<int>(level_) - 1);
+    } else {
+        return false;
+    }
+    // 段階を変えた効果が平均に現れるまで次の判定を待つ
+    over_scans_ = 0;
+    under_scans_ = 0;
+    return true;
+}
+} // namespace WallTracking
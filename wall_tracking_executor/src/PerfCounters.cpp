@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/PerfCounters.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace WallTracking{
+namespace {
+constexpr std::uint64_t kConfig[PerfCounters::COUNTER_NUM] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int perfEventOpen(std::uint64_t config, bool inherit)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = inherit ? 1 : 0;
+    // perf_event_paranoid=2でも開けるようにユーザ空間だけを数える
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+} // namespace
+
+PerfCounters::PerfCounters()
+{
+    for (int &fd : fd_) fd = -1;
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+bool PerfCounters::open(bool inherit, std::string &err)
+{
+    close();
+    int first_errno = 0;
+    for (int i = 0; i < COUNTER_NUM; ++i) {
+        fd_[i] = perfEventOpen(kConfig[i], inherit);
+        if (fd_[i] < 0 && first_errno == 0) first_errno = errno;
+    }
+    if (available()) return true;
+    err = std::string("perf_event_open: ") + std::strerror(first_errno);
+    if (first_errno == EACCES || first_errno == EPERM) err += " (check /proc/sys/kernel/perf_event_paranoid)";
+    return false;
+}
+
+void PerfCounters::close()
+{
+    for (int &fd : fd_) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+}
+
+bool PerfCounters::available() const
+{
+    for (int fd : fd_) {
+        if (fd >= 0) return true;
+    }
+    return false;
+}
+
+void PerfCounters::start()
+{
+    for (int fd : fd_) {
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+PerfSample PerfCounters::stop()
+{
+    std::int64_t values[COUNTER_NUM];
+    for (int i = 0; i < COUNTER_NUM; ++i) {
+        values[i] = -1;
+        if (fd_[i] < 0) continue;
+        ioctl(fd_[i], PERF_EVENT_IOC_DISABLE, 0);
+        std::uint64_t buf[3]; //value, time_enabled, time_running
+        if (read(fd_[i], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf)) || buf[2] == 0) continue;
+        // 多重化で一部の時間しか数えていない場合は有効時間に引き伸ばす
+        double scale = static_cast<double>(buf[1]) / static_cast<double>(buf[2]);
+        values[i] = static_cast<std::int64_t>(static_cast<double>(buf[0]) * scale);
+    }
+    PerfSample sample;
+    sample.cycles = values[CYCLES];
+    sample.instructions = values[INSTRUCTIONS];
+    sample.cache_misses = values[CACHE_MISSES];
+    sample.branch_misses = values[BRANCH_MISSES];
+    return sample;
+}
+} // namespace WallTracking
@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/Realtime.hpp>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace WallTracking{
+bool setThreadAffinity(int cpu, std::string &err)
+{
+    long cpu_num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu < 0 || cpu >= cpu_num) {
+        err = "cpu " + std::to_string(cpu) + " is out of range (online: " + std::to_string(cpu_num) + ")";
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        err = std::strerror(ret);
+        return false;
+    }
+    return true;
+}
+
+bool setThreadFifoPriority(int priority, std::string &err)
+{
+    int min = sched_get_priority_min(SCHED_FIFO), max = sched_get_priority_max(SCHED_FIFO);
+    if (priority < min || priority > max) {
+        err = "priority " + std::to_string(priority) + " is out of range [" +
+            std::to_string(min) + ", " + std::to_string(max) + "]";
+        return false;
+    }
+    sched_param param;
+    param.sched_priority = priority;
+    int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (ret != 0) {
+        err = std::strerror(ret);
+        return false;
+    }
+    return true;
+}
+
+bool lockProcessMemory(std::size_t prefault_heap_bytes, std::string &err)
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        err = std::strerror(errno);
+        return false;
+    }
+    // freeしたヒープをOSへ返さず、以後のmallocでページフォルトが起きないようにする
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    if (prefault_heap_bytes > 0) {
+        char *buf = static_cast<char *>(std::malloc(prefault_heap_bytes));
+        if (buf != nullptr) {
+            long page = sysconf(_SC_PAGESIZE);
+            for (std::size_t i = 0; i < prefault_heap_bytes; i += page) buf[i] = 0;
+            std::free(buf);
+        }
+    }
+    return true;
+}
+
+void prefaultStack(std::size_t bytes)
+{
+    volatile char *stack = static_cast<volatile char *>(alloca(bytes));
+    long page = sysconf(_SC_PAGESIZE);
+    for (std::size_t i = 0; i < bytes; i += page) stack[i] = 0;
+}
+} // namespace WallTracking
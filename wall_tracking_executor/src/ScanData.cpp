@@ -2,34 +2,152 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include<wall_tracking_executor/ScanData.hpp>
-#include<rclcpp/rclcpp.hpp>
+#include<algorithm>
+#include<limits>
 
 namespace WallTracking{
-ScanData::ScanData(sensor_msgs::msg::LaserScan::ConstSharedPtr msg)
+ScanData::ScanData(std::size_t capacity)
+: angle_min_(0.), angle_max_(0.), angle_increment_(0.), range_min_(0.), range_max_(0.),
+  time_increment_(0.), data_(nullptr), size_(0), deskew_angular_z_(std::numeric_limits<float>::quiet_NaN())
 {
-    angle_min_ = RAD2DEG(msg->angle_min);
-    angle_max_ = RAD2DEG(msg->angle_max);
-    angle_increment_ = RAD2DEG(msg->angle_increment);
-    range_max_ = msg->range_max;
-    range_min_ = msg->range_min;
-    // tmp_scan_msg_->ranges.resize(msg->ranges.size());
+    // reserveしておけば、capacity以下のスキャンでは以後の確保が発生しない
+    ranges_.reserve(capacity);
+    beam_cos_.reserve(capacity);
+    beam_sin_.reserve(capacity);
+    beam_dt_.reserve(capacity);
+    rot_cos_.reserve(capacity);
+    rot_sin_.reserve(capacity);
+    shift_x_.reserve(capacity);
+    shift_y_.reserve(capacity);
+    px_.reserve(capacity);
+    py_.reserve(capacity);
+    hit_.reserve(capacity);
+}
+
+void ScanData::setGeometry(const ScanGeometry &geometry, std::size_t size)
+{
+    geometry_ = geometry;
+    angle_min_ = RAD2DEG(geometry.angle_min);
+    angle_max_ = RAD2DEG(geometry.angle_max);
+    angle_increment_ = RAD2DEG(geometry.angle_increment);
+    range_max_ = geometry.range_max;
+    range_min_ = geometry.range_min;
+    time_increment_ = geometry.time_increment;
+    size_ = size;
+    initBeamTable(size_);
+}
+
+void ScanData::initBeamTable(std::size_t size)
+{
+    beam_cos_.resize(size);
+    beam_sin_.resize(size);
+    beam_dt_.resize(size);
+    rot_cos_.resize(size);
+    rot_sin_.resize(size);
+    shift_x_.resize(size);
+    shift_y_.resize(size);
+    deskew_angular_z_ = std::numeric_limits<float>::quiet_NaN();
+    px_.resize(size);
+    py_.resize(size);
+    hit_.resize(size);
+    ranges_.resize(size);
+    // 各ビームの計測時刻をスキャン終了時刻基準で表す(<=0)
+    float end_time = time_increment_ * static_cast<float>(size > 0 ? size - 1 : 0);
+    for (std::size_t i = 0; i < size; ++i) {
+        float rad = index2rad(i);
+        beam_cos_[i] = cos(rad);
+        beam_sin_[i] = sin(rad);
+        beam_dt_[i] = time_increment_ * static_cast<float>(i) - end_time;
+    }
 }
 
 ScanData::~ScanData()
 {
 }
 
-// void ScanData::dataUpdate(std::vector<float> ranges)
-// {
-//     if(ranges.size() != tmp_scan_msg_->ranges.size()) tmp_scan_msg_->ranges.resize(ranges.size());
-//     for(int i=0; i<ranges.size(); ++i) tmp_scan_msg_->ranges[i] = ranges[i];
-// }
+void ScanData::dataUpdate(RangeView ranges, const ScanGeometry &geometry)
+{
+    data_ = ranges.data();
+    if (ranges.size() != size_ || geometry != geometry_) setGeometry(geometry, ranges.size());
+}
 
-void ScanData::dataUpdate(sensor_msgs::msg::LaserScan::ConstSharedPtr msg)
+void ScanData::updateDeskewTable(float angular_z)
 {
-    // if(ranges.size() != tmp_scan_msg_->ranges.size()) tmp_scan_msg_->ranges.resize(ranges.size());
-    // for(int i=0; i<ranges.size(); ++i) tmp_scan_msg_->ranges[i] = ranges[i];
-    tmp_scan_msg_ = msg;
+    // 旋回角はビームの時刻ずれに比例するので、角速度が前回と同じなら表をそのまま使う
+    if (angular_z == deskew_angular_z_) return;
+    deskew_angular_z_ = angular_z;
+    const float *dt = beam_dt_.data();
+    // 半角のsin/cosから倍角を作る。半角が0.8rad以内なら多項式でfloatの精度が出る
+    float max_half = 0.5f * std::fabs(angular_z * (size_ > 0 ? dt[0] : 0.f));
+    if (!(max_half <= 0.8f)) {
+        for (std::size_t i = 0; i < size_; ++i) {
+            float h = 0.5f * angular_z * dt[i];
+            float hc = std::cos(h), hs = std::sin(h);
+            rot_cos_[i] = hc * hc - hs * hs;
+            rot_sin_[i] = 2.f * hs * hc;
+            shift_x_[i] = dt[i] * hc;
+            shift_y_[i] = dt[i] * hs;
+        }
+        return;
+    }
+    // libmを呼ばない分岐なしのループなのでベクトル化される
+    for (std::size_t i = 0; i < size_; ++i) {
+        float h = 0.5f * angular_z * dt[i];
+        float h2 = h * h;
+        float hs = h * (1.f + h2 * (-1.f / 6 + h2 * (1.f / 120 + h2 * (-1.f / 5040))));
+        float hc = 1.f + h2 * (-0.5f + h2 * (1.f / 24 + h2 * (-1.f / 720 + h2 * (1.f / 40320))));
+        rot_cos_[i] = hc * hc - hs * hs;
+        rot_sin_[i] = 2.f * hs * hc;
+        shift_x_[i] = dt[i] * hc;
+        shift_y_[i] = dt[i] * hs;
+    }
+}
+
+// 等速の並進・旋回を仮定し、各ビームをスキャン終了時刻のロボット座標系へ補正する
+void ScanData::deskew(float linear_x, float angular_z)
+{
+    // 補正済みのスキャンを補正し直すと、入力を読みながらranges_を埋め直すことになるので何もしない
+    if (time_increment_ == 0. || size_ == 0 || data_ == ranges_.data()) return;
+    updateDeskewTable(angular_z);
+    const float *in = data_;
+    float *px = px_.data(), *py = py_.data();
+    const float *c = rot_cos_.data(), *s = rot_sin_.data();
+    const float *sx = shift_x_.data(), *sy = shift_y_.data();
+    const float *bc = beam_cos_.data(), *bs = beam_sin_.data();
+    // 三角関数は表にあるので、分岐なしの積和だけのループにしてベクトル化させる。
+    // 1つのループでpxとpyを書くと実行時のエイリアス検査が多すぎてベクトル化されないので分ける
+    for (std::size_t i = 0; i < size_; ++i) {
+        px[i] = c[i] * in[i] * bc[i] - s[i] * in[i] * bs[i] + linear_x * sx[i];
+    }
+    for (std::size_t i = 0; i < size_; ++i) {
+        py[i] = s[i] * in[i] * bc[i] + c[i] * in[i] * bs[i] + linear_x * sy[i];
+    }
+    std::fill(ranges_.begin(), ranges_.end(), std::numeric_limits<float>::infinity());
+    std::fill(hit_.begin(), hit_.end(), 0);
+    float inc_rad = DEG2RAD(angle_increment_), min_rad = DEG2RAD(angle_min_);
+    const float two_pi = 2. * M_PI;
+    const int n = static_cast<int>(size_);
+    // 一周するスキャンでは最後のビンの次が先頭のビンになる
+    const bool full_circle = inc_rad * static_cast<float>(n) >= two_pi - 0.5f * inc_rad;
+    for (std::size_t i = 0; i < size_; ++i) {
+        float r = in[i];
+        if (!(r >= range_min_ && r <= range_max_)) continue;
+        // 開始角より手前の方向は一周ぶん先に送る(一周しないスキャンでは範囲外になって捨てられる)
+        float a = atan2f(py[i], px[i]) - min_rad;
+        if (a < 0.f) a += two_pi;
+        int j = static_cast<int>(lroundf(a / inc_rad));
+        if (full_circle && j >= n) j -= n;
+        if (j < 0 || j >= n) continue;
+        ranges_[j] = std::min(ranges_[j], hypotf(px[i], py[i]));
+        hit_[j] = 1;
+    }
+    // 補正後のビームが1本も落ちなかったビンに生の値は残さない。
+    // 元々有効だったビンの1つだけの抜けは両隣の近い方で埋め、それ以外は計測なし(inf)のままにする
+    for (std::size_t j = 1; j + 1 < size_; ++j) {
+        if (hit_[j] || !hit_[j - 1] || !hit_[j + 1]) continue;
+        if (in[j] >= range_min_ && in[j] <= range_max_) ranges_[j] = std::min(ranges_[j - 1], ranges_[j + 1]);
+    }
+    data_ = ranges_.data();
 }
 
 float ScanData::frontWallCheck(float start_deg, float threshold)
@@ -38,7 +156,7 @@ float ScanData::frontWallCheck(float start_deg, float threshold)
     int end_index = deg2index(-start_deg);
     float sum = 0, sum_i = 0;
     for (int i = start_index; i <= end_index; ++i) {
-        float range = tmp_scan_msg_->ranges[i] * cos(index2rad(i));
+        float range = data_[i] * cos(index2rad(i));
         sum += (range > range_min_ && range < threshold);
         ++sum_i;
     }
@@ -53,7 +171,7 @@ float ScanData::leftWallCheck(float start_deg, float end_deg)
     int start_index = deg2index(start_deg);
     int end_index = deg2index(end_deg);
     for (int i = start_index; i <= end_index; ++i) {
-        float add = (tmp_scan_msg_->ranges[i] != INFINITY && tmp_scan_msg_->ranges[i] != NAN) ? tmp_scan_msg_->ranges[i] * fabsf(sin(index2rad(i))) : range_max_;
+        float add = (data_[i] != INFINITY && data_[i] != NAN) ? data_[i] * fabsf(sin(index2rad(i))) : range_max_;
         sum += add;
         ++sum_i;
     }
@@ -70,7 +188,7 @@ void ScanData::openPlaceCheck(float start_deg, float end_deg, float threshold, f
     int sum = 0, sum_i = 0, sum_n = 0.;
     float sum_l = 0.;
     for(int i=start_index; i<=end_index; ++i){
-        float range = tmp_scan_msg_->ranges[i];
+        float range = data_[i];
         sum += (range < range_min_ || range >= threshold || range == INFINITY);
         if(range >= threshold){
             sum_l += range;
@@ -85,7 +203,7 @@ void ScanData::openPlaceCheck(float start_deg, float end_deg, float threshold, f
 bool ScanData::conflictCheck(float deg, float threshold)
 {
     float rad = DEG2RAD(deg);
-    float range = tmp_scan_msg_->ranges[deg2index(deg)] * sin(rad);
+    float range = data_[deg2index(deg)] * sin(rad);
     if(range  > threshold) return true;
     return false;
 }
@@ -93,13 +211,13 @@ bool ScanData::conflictCheck(float deg, float threshold)
 bool ScanData::thresholdCheck(float deg, float threshold)
 {
     int index = deg2index(deg);
-    if(tmp_scan_msg_->ranges[index] > threshold) return true;
+    if(data_[index] > threshold) return true;
     else return false;
 }
 
 bool ScanData::noiseCheck(float deg){
     int index = deg2index(deg);
-    if(tmp_scan_msg_->ranges[index] < range_min_ || std::isnan(tmp_scan_msg_->ranges[index])) return true;
+    if(data_[index] < range_min_ || std::isnan(data_[index])) return true;
     return false;
 }
 
@@ -108,4 +226,4 @@ int ScanData::deg2index(float deg) { return (deg - angle_min_) / angle_increment
 float ScanData::index2deg(int index) { return index * angle_increment_ + angle_min_; }
 
 float ScanData::index2rad(int index) { return index2deg(index) * M_PI / 180; }
-} // namespace ScanData
\ No newline at end of file
+} // namespace WallTracking
\ No newline at end of file
@@ -0,0 +1,140 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/ScanFuser.hpp>
+#include <wall_tracking_executor/FastMath.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace WallTracking{
+ScanFuser::ScanFuser()
+: size_(0), sensors_fused_(0)
+{
+}
+
+bool ScanFuser::configure(const VirtualScanConfig &config, const std::vector<SensorPose> &poses,
+    std::size_t beam_capacity, std::string &err)
+{
+    if (poses.empty()) {
+        err = "at least one sensor is required";
+        return false;
+    }
+    if (!(config.angle_increment_deg > 0.) || !(config.angle_min_deg < config.angle_max_deg)) {
+        err = "virtual scan angle range must be increasing with a positive increment";
+        return false;
+    }
+    if (!(config.range_min >= 0.) || !(config.range_min < config.range_max)) {
+        err = "virtual scan range_min must be in [0, range_max)";
+        return false;
+    }
+    config_ = config;
+    size_ = static_cast<std::size_t>(
+        std::ceil((config.angle_max_deg - config.angle_min_deg) / config.angle_increment_deg));
+    geometry_.angle_min = DEG2RAD(config.angle_min_deg);
+    geometry_.angle_increment = DEG2RAD(config.angle_increment_deg);
+    geometry_.angle_max = geometry_.angle_min + geometry_.angle_increment * static_cast<float>(size_ - 1);
+    // 時刻合わせはfuse()で済ませるのでdeskewは行わない
+    geometry_.time_increment = 0.;
+    geometry_.range_min = config.range_min;
+    geometry_.range_max = config.range_max;
+    bins_.assign(size_ + 1, std::numeric_limits<float>::infinity());
+    sensors_.assign(poses.size(), Sensor());
+    for (std::size_t i = 0; i < poses.size(); ++i) {
+        Sensor &s = sensors_[i];
+        s.pose = poses[i];
+        s.ranges.reserve(beam_capacity);
+        s.beam_cos.reserve(beam_capacity);
+        s.beam_sin.reserve(beam_capacity);
+    }
+    sensors_fused_ = 0;
+    return true;
+}
+
+bool ScanFuser::update(std::size_t sensor, std::int64_t stamp_ns, RangeView ranges, const ScanGeometry &geometry)
+{
+    if (sensor >= sensors_.size()) return false;
+    Sensor &s = sensors_[sensor];
+    if (ranges.size() > s.ranges.capacity()) return false;
+    if (ranges.size() != s.size || geometry != s.geometry) {
+        // ジオメトリが変わったときだけビーム方向を計算し直す
+        s.geometry = geometry;
+        s.size = ranges.size();
+        s.ranges.resize(s.size);
+        s.beam_cos.resize(s.size);
+        s.beam_sin.resize(s.size);
+        float yaw = DEG2RAD(s.pose.yaw_deg);
+        for (std::size_t i = 0; i < s.size; ++i) {
+            float th = yaw + geometry.angle_min + geometry.angle_increment * static_cast<float>(i);
+            s.beam_cos[i] = std::cos(th);
+            s.beam_sin[i] = std::sin(th);
+        }
+    }
+    std::copy(ranges.begin(), ranges.end(), s.ranges.begin());
+    s.stamp_ns = stamp_ns;
+    s.received = true;
+    return true;
+}
+
+std::int64_t ScanFuser::newestStamp() const
+{
+    std::int64_t newest = 0;
+    for (const Sensor &sensor : sensors_) {
+        if (sensor.received) newest = std::max(newest, sensor.stamp_ns);
+    }
+    return newest;
+}
+
+void ScanFuser::scatter(const Sensor &sensor, float dx, float dy, float dth)
+{
+    // センサ計測時刻のベース座標系 -> 基準時刻のベース座標系
+    const float c = std::cos(-dth), s = std::sin(-dth);
+    const float tx = c * (sensor.pose.x - dx) - s * (sensor.pose.y - dy);
+    const float ty = s * (sensor.pose.x - dx) + c * (sensor.pose.y - dy);
+    const float in_min = sensor.geometry.range_min, in_max = sensor.geometry.range_max;
+    const float r2_min = config_.range_min * config_.range_min;
+    const float r2_max = config_.range_max * config_.range_max;
+    const float angle_min = geometry_.angle_min, inv_inc = 1.f / geometry_.angle_increment;
+    const float sink = static_cast<float>(size_);
+    const float *r = sensor.ranges.data();
+    const float *bc = sensor.beam_cos.data(), *bs = sensor.beam_sin.data();
+    float *bins = bins_.data();
+    float range[kChunk];
+    int bin[kChunk];
+    for (std::size_t begin = 0; begin < sensor.size; begin += kChunk) {
+        std::size_t n = std::min(kChunk, sensor.size - begin);
+        // 分岐なしにしてベクトル化させる (CloudProjectorと同じくatan2は近似、負のbは無効なので切り捨て)。
+        // 無効なビームは捨て場のビンに送る
+        for (std::size_t j = 0; j < n; ++j) {
+            std::size_t i = begin + j;
+            float lx = r[i] * bc[i], ly = r[i] * bs[i];
+            float x = tx + c * lx - s * ly, y = ty + s * lx + c * ly;
+            float r2 = x * x + y * y;
+            float b = (atan2Approx(y, x) - angle_min) * inv_inc;
+            bool valid = (r[i] >= in_min) & (r[i] <= in_max) & (r2 >= r2_min) & (r2 <= r2_max) &
+                (b >= 0.f) & (b < sink);
+            bin[j] = static_cast<int>(valid ? b : sink);
+            range[j] = std::sqrt(r2);
+        }
+        // 複数のビームが同じビンに落ちうるので最小値の書き戻しはスカラーのまま
+        for (std::size_t j = 0; j < n; ++j) bins[bin[j]] = std::min(bins[bin[j]], range[j]);
+    }
+}
+
+std::size_t ScanFuser::fuse(std::int64_t stamp_ns, std::int64_t max_skew_ns, float linear_x, float angular_z)
+{
+    std::fill(bins_.begin(), bins_.end(), std::numeric_limits<float>::infinity());
+    sensors_fused_ = 0;
+    for (const Sensor &sensor : sensors_) {
+        if (!sensor.received) continue;
+        std::int64_t skew = stamp_ns - sensor.stamp_ns;
+        if (skew > max_skew_ns || skew < -max_skew_ns) continue;
+        // 等速の並進・旋回を仮定して基準時刻までの移動量を求める
+        float dt = static_cast<float>(skew) * 1e-9f;
+        float dth = angular_z * dt;
+        float dx = linear_x * dt * std::cos(dth * 0.5f), dy = linear_x * dt * std::sin(dth * 0.5f);
+        scatter(sensor, dx, dy, dth);
+        ++sensors_fused_;
+    }
+    return sensors_fused_;
+}
+} // namespace WallTracking
@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/ScanWatchdog.hpp>
+
+#include <algorithm>
+
+namespace WallTracking{
+ScanWatchdog::ScanWatchdog(double timeout, double gap_factor)
+: timeout_(timeout), gap_factor_(gap_factor)
+{
+    reset();
+}
+
+void ScanWatchdog::reset()
+{
+    last_scan_time_ = -1.;
+    mean_interval_ = 0.;
+    max_interval_ = 0.;
+    scan_count_ = 0;
+    gap_count_ = 0;
+    timeout_count_ = 0;
+    timed_out_ = false;
+}
+
+double ScanWatchdog::scanReceived(double now)
+{
+    double interval = 0.;
+    if (last_scan_time_ >= 0.) {
+        interval = now - last_scan_time_;
+        // 平均周期より大きく空いた間隔を欠落(ギャップ)として数える
+        if (mean_interval_ > 0. && interval > gap_factor_ * mean_interval_) ++gap_count_;
+        mean_interval_ = mean_interval_ == 0. ? interval : 0.95 * mean_interval_ + 0.05 * interval;
+        max_interval_ = std::max(max_interval_, interval);
+    }
+    last_scan_time_ = now;
+    ++scan_count_;
+    timed_out_ = false;
+    return interval;
+}
+
+bool ScanWatchdog::check(double now)
+{
+    if (last_scan_time_ < 0. || timed_out_) return false;
+    if (now - last_scan_time_ > timeout_) {
+        timed_out_ = true;
+        ++timeout_count_;
+        return true;
+    }
+    return false;
+}
+
+double ScanWatchdog::timeSinceLastScan(double now) const
+{
+    return last_scan_time_ < 0. ? 0. : now - last_scan_time_;
+}
+
+double ScanWatchdog::scanRate() const
+{
+    return mean_interval_ > 0. ? 1. / mean_interval_ : 0.;
+}
+} // namespace WallTracking
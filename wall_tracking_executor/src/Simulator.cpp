@@ -0,0 +1,313 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/Simulator.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+
+namespace WallTracking{
+void World::addSegment(float x0, float y0, float x1, float y1)
+{
+    x0_.push_back(x0);
+    y0_.push_back(y0);
+    ex_.push_back(x1 - x0);
+    ey_.push_back(y1 - y0);
+}
+
+void World::addPolyline(const std::vector<float> &xy, bool closed)
+{
+    std::size_t n = xy.size() / 2;
+    for (std::size_t i = 0; i + 1 < n; ++i) addSegment(xy[2 * i], xy[2 * i + 1], xy[2 * i + 2], xy[2 * i + 3]);
+    if (closed && n > 2) addSegment(xy[2 * n - 2], xy[2 * n - 1], xy[0], xy[1]);
+}
+
+bool World::load(const std::string &path, std::string &err)
+{
+    std::ifstream file(path);
+    if (!file) {
+        err = "cannot open " + path;
+        return false;
+    }
+    std::string line;
+    int line_no = 0;
+    while (std::getline(file, line)) {
+        ++line_no;
+        line = line.substr(0, line.find('#'));
+        std::istringstream ss(line);
+        std::vector<float> xy;
+        float v;
+        while (ss >> v) xy.push_back(v);
+        if (xy.empty()) continue;
+        if (xy.size() < 4 || xy.size() % 2 != 0) {
+            err = path + ":" + std::to_string(line_no) + ": a polyline needs at least two x y pairs";
+            return false;
+        }
+        addPolyline(xy, false);
+    }
+    return true;
+}
+
+World World::corridor(float length, float width)
+{
+    World world;
+    const float door = 1.0, door_x = length / 2;
+    world.addSegment(0., 0., length, 0.);
+    world.addSegment(0., width, door_x, width);
+    world.addSegment(door_x + door, width, length, width);
+    world.addSegment(0., 0., 0., width);
+    world.addSegment(length, 0., length, width);
+    return world;
+}
+
+World World::loop(float outer_x, float outer_y, float width)
+{
+    World world;
+    world.addPolyline({0., 0., outer_x, 0., outer_x, outer_y, 0., outer_y}, true);
+    world.addPolyline({width, width, outer_x - width, width, outer_x - width, outer_y - width, width, outer_y - width}, true);
+    return world;
+}
+
+float World::distanceToWall(float x, float y) const
+{
+    float best = std::numeric_limits<float>::infinity();
+    for (std::size_t k = 0; k < x0_.size(); ++k) {
+        float wx = x - x0_[k], wy = y - y0_[k];
+        float len2 = ex_[k] * ex_[k] + ey_[k] * ey_[k];
+        float u = len2 > 0. ? std::clamp((wx * ex_[k] + wy * ey_[k]) / len2, 0.f, 1.f) : 0.f;
+        float dx = wx - u * ex_[k], dy = wy - u * ey_[k];
+        best = std::min(best, dx * dx + dy * dy);
+    }
+    return std::sqrt(best);
+}
+
+// 組み込みのワールドでは左の壁からdistance_from_wallの位置から走り始める
+bool makeWorld(const std::string &name, float distance_from_wall, World &world, Pose2D &start, std::string &err)
+{
+    if (name == "corridor") {
+        world = World::corridor(30., 3.);
+        start.x = 1.;
+        start.y = 3. - distance_from_wall;
+        start.yaw = 0.;
+    } else if (name == "loop") {
+        // 外周の壁を左に見ながら時計回りに走る
+        world = World::loop(20., 12., 3.);
+        start.x = 17.;
+        start.y = distance_from_wall;
+        start.yaw = M_PI;
+    } else {
+        if (!world.load(name, err)) return false;
+        start = Pose2D();
+    }
+    return true;
+}
+LidarSimulator::LidarSimulator(const LidarModel &model)
+: model_(model)
+{
+    std::size_t beams = static_cast<std::size_t>(std::max(model.beams, 1));
+    float inc_deg = (model.angle_max_deg - model.angle_min_deg) / static_cast<float>(beams);
+    geometry_.angle_min = DEG2RAD(model.angle_min_deg);
+    geometry_.angle_increment = DEG2RAD(inc_deg);
+    geometry_.angle_max = geometry_.angle_min + geometry_.angle_increment * static_cast<float>(beams - 1);
+    geometry_.time_increment = 0.;
+    geometry_.range_min = model.range_min;
+    geometry_.range_max = model.range_max;
+    beam_cos_.resize(beams);
+    beam_sin_.resize(beams);
+    for (std::size_t b = 0; b < beams; ++b) {
+        float th = geometry_.angle_min + geometry_.angle_increment * static_cast<float>(b);
+        beam_cos_[b] = std::cos(th);
+        beam_sin_[b] = std::sin(th);
+    }
+    dx_.resize(beams);
+    dy_.resize(beams);
+    ranges_.resize(beams);
+}
+
+RangeView LidarSimulator::scan(const World &world, float x, float y, float yaw, std::mt19937 &rng)
+{
+    const std::size_t beams = ranges_.size();
+    const float c = std::cos(yaw), s = std::sin(yaw);
+    float *dx = dx_.data(), *dy = dy_.data(), *r = ranges_.data();
+    for (std::size_t b = 0; b < beams; ++b) {
+        dx[b] = c * beam_cos_[b] - s * beam_sin_[b];
+        dy[b] = s * beam_cos_[b] + c * beam_sin_[b];
+        r[b] = std::numeric_limits<float>::infinity();
+    }
+    // 壁ごとに全ビームとの交差を求める。内側のループは分岐なしでベクトル化される
+    for (std::size_t k = 0; k < world.x0_.size(); ++k) {
+        const float px = world.x0_[k] - x, py = world.y0_[k] - y;
+        const float ex = world.ex_[k], ey = world.ey_[k];
+        for (std::size_t b = 0; b < beams; ++b) {
+            float inv = 1.f / (dx[b] * ey - dy[b] * ex);
+            float t = (px * ey - py * ex) * inv;
+            float u = (px * dy[b] - py * dx[b]) * inv;
+            bool hit = t > 0.f && u >= 0.f && u <= 1.f && t < r[b];
+            r[b] = hit ? t : r[b];
+        }
+    }
+    std::normal_distribution<float> noise(0., model_.noise_stddev);
+    std::uniform_real_distribution<float> uniform(0., 1.);
+    for (std::size_t b = 0; b < beams; ++b) {
+        if (model_.noise_stddev > 0.) r[b] += noise(rng);
+        if (r[b] > model_.range_max) r[b] = std::numeric_limits<float>::infinity();
+        if (model_.dropout > 0. && uniform(rng) < model_.dropout) r[b] = std::numeric_limits<float>::infinity();
+    }
+    return RangeView(ranges_);
+}
+
+EpisodeResult runEpisode(const EpisodeConfig &config)
+{
+    EpisodeResult result;
+    if (config.world == nullptr || config.params.sampling_rate <= 0.) return result;
+    const World &world = *config.world;
+    LidarSimulator lidar(config.lidar);
+    ScanData scan(static_cast<std::size_t>(std::max(config.lidar.beams, 0)));
+    WallFollower follower;
+    follower.setParams(config.params);
+    std::mt19937 rng(config.seed);
+    FollowerInput input;
+    input.outdoor = config.outdoor;
+    input.gnss_nan = !config.outdoor;
+    input.navigating = true;
+
+    const float dt = config.params.sampling_rate;
+    const int substeps = std::max(config.substeps, 1);
+    Pose2D pose = config.start;
+    double err2 = 0.;
+    std::uint64_t err_n = 0;
+    float t = 0.;
+    const bool has_mission = config.mission_distance > 0.;
+    while (t < config.duration && !result.collided && !result.completed) {
+        scan.dataUpdate(lidar.scan(world, pose.x, pose.y, pose.yaw, rng), lidar.geometry());
+        const Decision &decision = follower.step(scan, input);
+        float hold = dt;
+        switch (decision.action) {
+        case FollowAction::TURN:
+            ++result.turns;
+            hold = std::max(dt, config.turn_hold);
+            break;
+        case FollowAction::GAP_SKIP:
+            ++result.gap_skips;
+            break;
+        case FollowAction::WALL_TRACK:
+        {
+            float e = world.distanceToWall(pose.x, pose.y) - config.params.distance_from_wall;
+            err2 += e * e;
+            ++err_n;
+            result.max_wall_error = std::max(result.max_wall_error, std::fabs(e));
+            break;
+        }
+        default:
+            break;
+        }
+        // 差動二輪の運動学を円弧で積分する
+        float h = hold / static_cast<float>(substeps);
+        for (int i = 0; i < substeps && !result.collided; ++i) {
+            float v = decision.linear_x, w = decision.angular_z;
+            float mid = pose.yaw + 0.5f * w * h;
+            pose.x += v * h * std::cos(mid);
+            pose.y += v * h * std::sin(mid);
+            pose.yaw = std::remainder(pose.yaw + w * h, 2.f * static_cast<float>(M_PI));
+            result.distance += std::fabs(v) * h;
+            t += h;
+            result.collided = world.distanceToWall(pose.x, pose.y) < config.robot_radius;
+        }
+        result.completed = has_mission && !result.collided && result.distance >= config.mission_distance;
+        ++result.steps;
+    }
+    result.sim_time = t;
+    result.rms_wall_error = err_n > 0 ? static_cast<float>(std::sqrt(err2 / static_cast<double>(err_n))) : 0.f;
+    result.final_pose = pose;
+    return result;
+}
+
+std::vector<EpisodeResult> runEpisodes(const std::vector<EpisodeConfig> &configs, std::size_t threads)
+{
+    std::vector<EpisodeResult> results(configs.size());
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, std::max<std::size_t>(configs.size(), 1));
+    // エピソードの長さがばらつくので、空いたスレッドが次の番号を取りに行く
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]() {
+        for (std::size_t i = next.fetch_add(1); i < configs.size(); i = next.fetch_add(1)) {
+            results[i] = runEpisode(configs[i]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < threads; ++i) pool.emplace_back(worker);
+    worker();
+    for (auto &th : pool) th.join();
+    return results;
+}
+
+bool loadControlParams(const std::string &path, ControlParams &p, std::string &err)
+{
+    std::ifstream file(path);
+    if (!file) {
+        err = "cannot open " + path;
+        return false;
+    }
+    // "key: value" と複数行にまたがる "key: [a, b, ...]" だけを読む
+    std::map<std::string, std::vector<double>> values;
+    std::string line, key, pending;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        if (!key.empty()) {
+            pending += " " + line;
+        } else {
+            std::size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::size_t begin = line.find_first_not_of(" \t");
+            key = line.substr(begin, colon - begin);
+            pending = line.substr(colon + 1);
+        }
+        if (pending.find('[') != std::string::npos && pending.find(']') == std::string::npos) continue;
+        std::replace_if(pending.begin(), pending.end(), [](char ch) { return ch == '[' || ch == ']' || ch == ','; }, ' ');
+        std::istringstream ss(pending);
+        std::vector<double> v;
+        double d;
+        while (ss >> d) v.push_back(d);
+        if (!v.empty()) values[key] = v;
+        key.clear();
+    }
+    auto scalar = [&](const char *name, auto &out) {
+        auto it = values.find(name);
+        if (it == values.end() || it->second.size() != 1) {
+            err = std::string(name) + " is missing in " + path;
+            return false;
+        }
+        out = static_cast<std::remove_reference_t<decltype(out)>>(it->second[0]);
+        return true;
+    };
+    if (!scalar("max_linear_vel", p.max_linear_vel) || !scalar("max_angular_vel", p.max_angular_vel) ||
+        !scalar("min_angular_vel", p.min_angular_vel) || !scalar("distance_from_wall", p.distance_from_wall) ||
+        !scalar("distance_to_stop", p.distance_to_stop) || !scalar("sampling_rate", p.sampling_rate) ||
+        !scalar("kp", p.kp) || !scalar("ki", p.ki) || !scalar("kd", p.kd) ||
+        !scalar("start_deg_lateral", p.start_deg_lateral) || !scalar("end_deg_lateral", p.end_deg_lateral) ||
+        !scalar("stop_ray_th", p.stop_ray_th) || !scalar("wheel_separation", p.wheel_separation) ||
+        !scalar("distance_to_skip", p.distance_to_skip) || !scalar("open_place_distance", p.open_place_distance)) {
+        return false;
+    }
+    const std::vector<double> &detection_div_deg = values["detection_div_deg"];
+    const std::vector<double> &select_angvel = values["select_angvel"];
+    if (detection_div_deg.size() != 2 * select_angvel.size()) {
+        err = "detection_div_deg must have two angles for each select_angvel";
+        return false;
+    }
+    p.sector_num = static_cast<int>(select_angvel.size());
+    if (p.sector_num > ControlParams::kMaxSectors) p.sector_num = -1;
+    for (int i = 0; i < p.sector_num; ++i) {
+        p.select_angvel[i] = select_angvel[i];
+        p.detection_div_deg[2 * i] = detection_div_deg[2 * i];
+        p.detection_div_deg[2 * i + 1] = detection_div_deg[2 * i + 1];
+    }
+    return computeDerived(p, err);
+}
+} // namespace WallTracking
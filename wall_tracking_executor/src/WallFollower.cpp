@@ -0,0 +1,146 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <wall_tracking_executor/WallFollower.hpp>
+#include <wall_tracking_executor/Tracing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+
+namespace WallTracking{
+WallFollower::WallFollower()
+{
+    sortSectors();
+    reset();
+}
+
+void WallFollower::sortSectors()
+{
+    const float *div = params_.detection_div_deg;
+    auto centre = [div](int j) { return std::fabs(div[2 * j] + div[2 * j + 1]); };
+    std::iota(std::begin(sector_order_), std::end(sector_order_), 0);
+    std::stable_sort(sector_order_, sector_order_ + params_.sector_num,
+        [&centre](int a, int b) { return centre(a) < centre(b); });
+}
+
+void WallFollower::setParams(const ControlParams &params)
+{
+    // ゲインや周期、目標距離が変わったら古い積分値と前回の偏差を持ち越さない
+    if (params.kp != params_.kp || params.ki != params_.ki || params.kd != params_.kd ||
+        params.sampling_rate != params_.sampling_rate || params.distance_from_wall != params_.distance_from_wall) {
+        ei_ = 0.;
+        pre_e_ = 0.;
+    }
+    params_ = params;
+    sortSectors();
+    linear_vel_ = !open_place_ ? params_.max_linear_vel : params_.vel_open_place;
+}
+
+void WallFollower::reset()
+{
+    ei_ = 0.;
+    pre_e_ = 0.;
+    open_place_ = false;
+    linear_vel_ = params_.max_linear_vel;
+    decision_ = Decision();
+}
+
+const Decision &WallFollower::step(ScanData &scan, const FollowerInput &input)
+{
+    decision_ = Decision();
+    if (!input.outdoor) {
+        open_place_ = false;
+    } else {
+        float per, mean;
+        scan.openPlaceCheck(-90., 90., params_.open_place_distance, per, mean);
+        WALL_TRACKING_TRACEPOINT(sector_analysis, TRACE_OPEN_PLACE, -1, per);
+        open_place_ = !open_place_ ? (per >= 0.7) : per >= 0.4;
+        if (input.gnss_nan) open_place_ = false;
+        linear_vel_ = !open_place_ ? params_.max_linear_vel : params_.vel_open_place;
+        decision_.open_place_ratio = per;
+        decision_.open_place_mean = mean;
+    }
+    decision_.open_place = open_place_;
+    if (input.navigating) navigateOpenPlace(scan, input);
+    else setCommand(FollowAction::STOP, 0., 0.);
+    return decision_;
+}
+
+void WallFollower::setCommand(FollowAction action, float linear_x, float angular_z)
+{
+    decision_.action = action;
+    decision_.linear_x = std::min(linear_x, params_.max_linear_vel);
+    decision_.angular_z = std::max(std::min(angular_z, params_.max_angular_vel), params_.min_angular_vel);
+    WALL_TRACKING_TRACEPOINT(control_computed, static_cast<int>(action), decision_.linear_x, decision_.angular_z);
+}
+
+float WallFollower::lateralPidControl(float input)
+{
+    float e = input - params_.distance_from_wall;
+    ei_ += e * params_.sampling_rate;
+    float ed = (e - pre_e_) / params_.sampling_rate;
+    pre_e_ = e;
+    decision_.pid_p = e * params_.kp;
+    decision_.pid_i = ei_ * params_.ki;
+    decision_.pid_d = ed * params_.kd;
+    return decision_.pid_p + decision_.pid_i + decision_.pid_d;
+}
+
+void WallFollower::wallTracking(ScanData &scan)
+{
+    float gap_th = params_.distance_from_wall;
+    decision_.gap_start = scan.conflictCheck(params_.start_deg_lateral, gap_th);
+    decision_.gap_end = scan.conflictCheck(90., gap_th);
+    decision_.front_left_wall = scan.thresholdCheck(params_.flw_deg, 1.91);
+    if ((decision_.gap_start || decision_.gap_end) && !decision_.front_left_wall &&
+        !scan.noiseCheck(params_.flw_deg)) {
+        setCommand(FollowAction::GAP_SKIP, linear_vel_, 0.0);
+    } else {
+        decision_.lateral_mean = scan.leftWallCheck(params_.start_deg_lateral, params_.end_deg_lateral);
+        WALL_TRACKING_TRACEPOINT(sector_analysis, TRACE_LEFT_WALL, -1, decision_.lateral_mean);
+        float angular_z = lateralPidControl(decision_.lateral_mean);
+        setCommand(FollowAction::WALL_TRACK, linear_vel_, angular_z);
+    }
+}
+
+void WallFollower::navigateOpenPlace(ScanData &scan, const FollowerInput &input)
+{
+    decision_.front_wall_ratio = scan.frontWallCheck(params_.fwc_deg, params_.distance_to_stop);
+    WALL_TRACKING_TRACEPOINT(sector_analysis, TRACE_FRONT_WALL, -1, decision_.front_wall_ratio);
+    if (decision_.front_wall_ratio >= params_.stop_ray_th) {
+        // 旋回は速度制限をかけずにそのまま出す
+        decision_.action = FollowAction::TURN;
+        decision_.linear_x = 0.;
+        decision_.angular_z = DEG2RAD(-45);
+        WALL_TRACKING_TRACEPOINT(control_computed, static_cast<int>(decision_.action), decision_.linear_x, decision_.angular_z);
+        return;
+    }
+    if (!input.outdoor) {
+        wallTracking(scan);
+        return;
+    }
+    const int div_num = params_.sector_num;
+    int checks = div_num;
+    if (input.sector_limit > 0 && input.sector_limit < checks) checks = input.sector_limit;
+    float *evals = decision_.evals, *means = decision_.means;
+    // 評価しない扇形は選ばれないよう、どこも開けていない場合より低くしておく
+    std::fill(evals, evals + div_num, -1.f);
+    float per, mean;
+    for (int k = 0; k < checks; ++k) {
+        int j = sector_order_[k];
+        scan.openPlaceCheck(params_.detection_div_deg[2 * j], params_.detection_div_deg[2 * j + 1],
+            params_.open_place_distance, per, mean);
+        evals[j] = per < 0.7 ? -1. : per;
+        means[j] = mean;
+        WALL_TRACKING_TRACEPOINT(sector_analysis, TRACE_SECTOR, j, per);
+    }
+    // 最後の要素(0)はどの扇形も開けていない場合に選ばれる
+    int max_index = std::distance(evals, std::max_element(evals, evals + div_num + 1));
+    decision_.sector_num = div_num;
+    decision_.max_index = max_index;
+    if (max_index != div_num) setCommand(FollowAction::OPEN_PLACE, linear_vel_, params_.select_angvel[max_index]);
+    else wallTracking(scan);
+}
+} // namespace WallTracking
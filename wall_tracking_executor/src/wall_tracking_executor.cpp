@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "wall_tracking_executor/wall_tracking_executor.hpp"
+#include "wall_tracking_executor/Realtime.hpp"
+#include "wall_tracking_executor/Tracing.hpp"
 
 #include <algorithm>
 #include <chrono>
@@ -14,18 +16,308 @@
 using namespace std::chrono_literals;
 
 namespace WallTracking {
-WallTracking::WallTracking() : Node("wall_tracking_node") 
+namespace {
+ScanGeometry toScanGeometry(const sensor_msgs::msg::LaserScan &msg)
+{
+    ScanGeometry geometry;
+    geometry.angle_min = msg.angle_min;
+    geometry.angle_max = msg.angle_max;
+    geometry.angle_increment = msg.angle_increment;
+    geometry.time_increment = msg.time_increment;
+    geometry.range_min = msg.range_min;
+    geometry.range_max = msg.range_max;
+    return geometry;
+}
+
+bool toCloudLayout(const sensor_msgs::msg::PointCloud2 &msg, CloudLayout &layout)
+{
+    // ホストのバイトオーダーと異なる点群は扱わない
+    uint16_t probe = 1;
+    bool host_big_endian = *reinterpret_cast<uint8_t *>(&probe) == 0;
+    if(msg.is_bigendian != host_big_endian) return false;
+    int found = 0;
+    for(const auto & field : msg.fields){
+        if(field.datatype != sensor_msgs::msg::PointField::FLOAT32 || field.count != 1) continue;
+        if(field.name == "x"){ layout.x_offset = field.offset; found |= 1; }
+        else if(field.name == "y"){ layout.y_offset = field.offset; found |= 2; }
+        else if(field.name == "z"){ layout.z_offset = field.offset; found |= 4; }
+    }
+    if(found != 7) return false;
+    layout.data = msg.data.data();
+    layout.width = msg.width;
+    layout.height = msg.height;
+    layout.point_step = msg.point_step;
+    layout.row_step = msg.row_step;
+    // バッファに収まらないレイアウトは不正とする
+    return msg.data.size() >= static_cast<std::size_t>(msg.row_step) * msg.height;
+}
+
+// 誰も購読していないデバッグ出力はメッセージを作らずに済ませる
+template<typename PublisherT>
+bool hasSubscribers(const PublisherT & pub)
+{
+    return pub->get_subscription_count() > 0 || pub->get_intra_process_subscription_count() > 0;
+}
+} // namespace
+
+WallTracking::WallTracking(const rclcpp::NodeOptions & options)
+: rclcpp_lifecycle::LifecycleNode("wall_tracking_node", options)
 {
     set_param();
-    get_param();
+    param_callback_handle_ = this->add_on_set_parameters_callback(
+        std::bind(&WallTracking::parameters_callback, this, std::placeholders::_1));
+    // executorとコールバックグループの構成は起動時に決める
+    this->get_parameter("autostart", autostart_);
+    this->get_parameter("realtime_mode", realtime_mode_);
+    this->get_parameter("executor_type", executor_type_);
+    this->get_parameter("executor_threads", executor_threads_);
+    init_callback_group();
+    active_ = false;
+    wall_tracking_flg_ = false;
+    preempt_requested_ = false;
+    goal_active_ = false;
+    goal_worker_stop_ = false;
+    goal_worker_thread_ = std::thread(&WallTracking::goal_worker, this);
+}
+
+WallTracking::~WallTracking()
+{
+    {
+        std::lock_guard<std::mutex> lock(goal_mutex_);
+        goal_worker_stop_ = true;
+    }
+    goal_cv_.notify_all();
+    if(goal_worker_thread_.joinable()) goal_worker_thread_.join();
+}
+
+CallbackReturn WallTracking::on_configure([[maybe_unused]] const rclcpp_lifecycle::State & state)
+{
+    if(!get_param()) return CallbackReturn::FAILURE;
     init_variable();
+    if(!flight_recorder_path_.empty()){
+        std::string err;
+        std::size_t max_ranges = flight_recorder_ranges_ ? static_cast<std::size_t>(std::max(scan_beam_capacity_, 0)) : 0;
+        if(flight_recorder_.open(flight_recorder_path_, static_cast<std::size_t>(std::max(flight_recorder_slots_, 1)), max_ranges, err)){
+            RCLCPP_INFO(this->get_logger(), "Flight recorder: %s (%d scans, %lu recorded so far)",
+                flight_recorder_path_.c_str(), flight_recorder_slots_, static_cast<unsigned long>(flight_recorder_.recorded()));
+            if(!flight_recorder_.movedAside().empty()){
+                RCLCPP_WARN(this->get_logger(), "Flight recorder: existing file has another layout, moved to %s",
+                    flight_recorder_.movedAside().c_str());
+            }
+        }else{
+            RCLCPP_WARN(this->get_logger(), "Flight recorder disabled: %s", err.c_str());
+        }
+    }
+    if(!decision_trace_path_.empty()){
+        std::string err;
+        if(decision_trace_.open(decision_trace_path_, static_cast<std::size_t>(std::max(decision_trace_queue_, 2)), err)){
+            RCLCPP_INFO(this->get_logger(), "Decision trace: %s", decision_trace_path_.c_str());
+            if(!decision_trace_.movedAside().empty()){
+                RCLCPP_WARN(this->get_logger(), "Decision trace: existing file has another layout, moved to %s",
+                    decision_trace_.movedAside().c_str());
+            }
+        }else{
+            RCLCPP_WARN(this->get_logger(), "Decision trace disabled: %s", err.c_str());
+        }
+    }
     init_sub();
     init_pub();
     init_action();
+    init_timer();
+    init_diagnostics();
+    scan_gate_.open();
+    RCLCPP_INFO(this->get_logger(), "Configured");
+    return CallbackReturn::SUCCESS;
 }
 
-WallTracking::~WallTracking()
+CallbackReturn WallTracking::on_activate([[maybe_unused]] const rclcpp_lifecycle::State & state)
+{
+    cmd_vel_pub_->on_activate();
+    open_place_arrived_pub_->on_activate();
+    open_place_detection_pub_->on_activate();
+    behavior_stamped_array_pub_->on_activate();
+    handover_latency_pub_->on_activate();
+    // 状態トピックはactivate後の最初の値を必ず出す
+    open_place_arrived_published_ = false;
+    open_place_detection_msg_.data.clear();
+    scan_watchdog_->reset();
+    active_ = true;
+    RCLCPP_INFO(this->get_logger(), "Activated");
+    return CallbackReturn::SUCCESS;
+}
+
+CallbackReturn WallTracking::on_deactivate([[maybe_unused]] const rclcpp_lifecycle::State & state)
+{
+    stop_goal();
+    pub_cmd_vel(0., 0.);
+    active_ = false;
+    cmd_vel_pub_->on_deactivate();
+    open_place_arrived_pub_->on_deactivate();
+    open_place_detection_pub_->on_deactivate();
+    behavior_stamped_array_pub_->on_deactivate();
+    handover_latency_pub_->on_deactivate();
+    RCLCPP_INFO(this->get_logger(), "Deactivated");
+    return CallbackReturn::SUCCESS;
+}
+
+CallbackReturn WallTracking::on_cleanup([[maybe_unused]] const rclcpp_lifecycle::State & state)
+{
+    release();
+    RCLCPP_INFO(this->get_logger(), "Cleaned up");
+    return CallbackReturn::SUCCESS;
+}
+
+CallbackReturn WallTracking::on_shutdown([[maybe_unused]] const rclcpp_lifecycle::State & state)
+{
+    if(active_){
+        stop_goal();
+        pub_cmd_vel(0., 0.);
+        active_ = false;
+    }
+    release();
+    return CallbackReturn::SUCCESS;
+}
+
+void WallTracking::stop_goal()
 {
+    // 実行中のゴールを中断し、goal_workerが終了を知らせるまで待つ
+    std::unique_lock<std::mutex> lock(goal_mutex_);
+    if(pending_goal_){
+        // まだ開始していないゴールも始めさせない。受理時にEXECUTINGになっているのでそのまま中断する
+        auto result = std::make_shared<WallTrackingAction::Result>();
+        result->get = false;
+        pending_goal_->abort(result);
+        pending_goal_.reset();
+    }
+    if(goal_active_){
+        // release()はgoal_workerが使う資源を解放するので、終わるまで時間で打ち切らない。
+        // フィードバック待ちは10 msごとに中断を確認し、Nav2のキャンセル待ちもnav_cancel_timeoutで終わる
+        preempt_requested_ = true;
+        goal_cv_.notify_all();
+        goal_cv_.wait(lock, [this]() { return !goal_active_.load(); });
+    }
+    wall_tracking_flg_ = false;
+}
+
+void WallTracking::release()
+{
+    // リアルタイムのscanスレッドやマルチスレッドのexecutorでは、active_を落とした後も
+    // コールバックが実行中のことがある。購読を止め、抜けるのを待ってから資源を解放する
+    scan_sub_.reset();
+    cloud_sub_.reset();
+    fusion_subs_.clear();
+    watchdog_timer_.reset();
+    scan_gate_.close();
+    diagnostic_updater_.reset();
+    flight_recorder_.close();
+    // closeはキューを解放するので、pushするscanのコールバックが止まった後に呼ぶ
+    if(decision_trace_.isOpen()){
+        decision_trace_.close();
+        RCLCPP_INFO(this->get_logger(), "Decision trace: %lu written, %lu dropped",
+            static_cast<unsigned long>(decision_trace_.written()), static_cast<unsigned long>(decision_trace_.dropped()));
+    }
+    gnss_sub_.reset();
+    gnss_pose_with_covariance_sub_.reset();
+    goal_pose_sub_.reset();
+    odom_sub_.reset();
+    cmd_vel_pub_.reset();
+    open_place_arrived_pub_.reset();
+    open_place_detection_pub_.reset();
+    behavior_stamped_array_pub_.reset();
+    handover_latency_pub_.reset();
+    wall_tracking_action_srv_.reset();
+    navigation_action_client_.reset();
+    scan_data_.reset();
+    scan_watchdog_.reset();
+}
+
+bool WallTracking::autostart() const { return autostart_; }
+
+namespace {
+const char * const kControlParamNames[] = {
+    "max_linear_vel", "max_angular_vel", "min_angular_vel", "distance_from_wall", "distance_to_stop",
+    "sampling_rate", "kp", "ki", "kd", "start_deg_lateral", "end_deg_lateral", "stop_ray_th",
+    "wheel_separation", "distance_to_skip", "open_place_distance", "select_angvel", "detection_div_deg",
+};
+} // namespace
+
+bool WallTracking::read_control_params(
+    const std::vector<rclcpp::Parameter> & changes, ControlParams & p, std::string & err)
+{
+    // 変更要求にあるパラメータはその値を、それ以外は現在の値を使う
+    auto value = [&](const std::string & name) -> rclcpp::Parameter {
+        for (const auto & c : changes) if (c.get_name() == name) return c;
+        return this->get_parameter(name);
+    };
+    p.max_linear_vel = value("max_linear_vel").as_double();
+    p.max_angular_vel = value("max_angular_vel").as_double();
+    p.min_angular_vel = value("min_angular_vel").as_double();
+    p.distance_from_wall = value("distance_from_wall").as_double();
+    p.distance_to_stop = value("distance_to_stop").as_double();
+    p.sampling_rate = value("sampling_rate").as_double();
+    p.kp = value("kp").as_double();
+    p.ki = value("ki").as_double();
+    p.kd = value("kd").as_double();
+    p.start_deg_lateral = value("start_deg_lateral").as_int();
+    p.end_deg_lateral = value("end_deg_lateral").as_int();
+    p.stop_ray_th = value("stop_ray_th").as_double();
+    p.wheel_separation = value("wheel_separation").as_double();
+    p.distance_to_skip = value("distance_to_skip").as_double();
+    p.open_place_distance = value("open_place_distance").as_double();
+    std::vector<double> detection_div_deg = value("detection_div_deg").as_double_array();
+    std::vector<double> select_angvel = value("select_angvel").as_double_array();
+    if(detection_div_deg.size() != 2 * select_angvel.size()){
+        err = "detection_div_deg must have two angles for each select_angvel";
+        return false;
+    }
+    p.sector_num = static_cast<int>(select_angvel.size());
+    if(p.sector_num > ControlParams::kMaxSectors) p.sector_num = -1;
+    for(int i = 0; i < p.sector_num; ++i){
+        p.select_angvel[i] = select_angvel[i];
+        p.detection_div_deg[2 * i] = detection_div_deg[2 * i];
+        p.detection_div_deg[2 * i + 1] = detection_div_deg[2 * i + 1];
+    }
+    return computeDerived(p, err);
+}
+
+rcl_interfaces::msg::SetParametersResult WallTracking::parameters_callback(
+    const std::vector<rclcpp::Parameter> & parameters)
+{
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+    bool control_changed = false;
+    for(const auto & param : parameters){
+        for(const char * name : kControlParamNames) control_changed |= param.get_name() == name;
+    }
+    if(!control_changed) return result;
+    ControlParams candidate;
+    std::string err;
+    if(!read_control_params(parameters, candidate, err)){
+        result.successful = false;
+        result.reason = err;
+        return result;
+    }
+    // スキャン処理の合間に一括で差し替える
+    pending_params_.store(candidate);
+    RCLCPP_INFO(this->get_logger(), "Control parameters updated");
+    return result;
+}
+
+void WallTracking::apply_pending_params()
+{
+    uint32_t version = pending_params_.version();
+    if(version == applied_params_version_) return;
+    applied_params_version_ = version;
+    set_follower_params(pending_params_.load());
+}
+
+void WallTracking::set_follower_params(const ControlParams & params)
+{
+    follower_.setParams(params);
+    // pub_cmd_velはゴールのスレッドやdeactivateからも呼ばれるので、制限値はatomicで渡す
+    max_linear_vel_ = params.max_linear_vel;
+    max_angular_vel_ = params.max_angular_vel;
+    min_angular_vel_ = params.min_angular_vel;
 }
 
 void WallTracking::set_param()
@@ -47,52 +339,221 @@ void WallTracking::set_param()
     this->declare_parameter("open_place_distance", 0.0);
     this->declare_parameter("select_angvel", std::vector<double>(2, 0.0));
     this->declare_parameter("detection_div_deg", std::vector<double>(2, 0.0));
+    this->declare_parameter("autostart", true);
+    this->declare_parameter("scan_beam_capacity", 2048);
+    this->declare_parameter("deskew_scan", false);
+    this->declare_parameter("deskew_use_odom", true);
+    this->declare_parameter("realtime_mode", false);
+    this->declare_parameter("realtime_cpu", -1);
+    this->declare_parameter("realtime_priority", 80);
+    this->declare_parameter("realtime_lock_memory", true);
+    this->declare_parameter("scan_deadline", 0.0);
+    this->declare_parameter("scan_latest_only", false);
+    this->declare_parameter("cloud_input", false);
+    this->declare_parameter("cloud_min_height", -0.1);
+    this->declare_parameter("cloud_max_height", 0.5);
+    this->declare_parameter("cloud_angle_min_deg", -180.0);
+    this->declare_parameter("cloud_angle_max_deg", 180.0);
+    this->declare_parameter("cloud_angle_increment_deg", 0.25);
+    this->declare_parameter("cloud_range_min", 0.1);
+    this->declare_parameter("cloud_range_max", 30.0);
+    this->declare_parameter("fusion_scan_topics", std::vector<std::string>());
+    this->declare_parameter("fusion_sensor_poses", std::vector<double>());
+    this->declare_parameter("fusion_max_skew", 0.05);
+    this->declare_parameter("fusion_angle_min_deg", -180.0);
+    this->declare_parameter("fusion_angle_max_deg", 180.0);
+    this->declare_parameter("fusion_angle_increment_deg", 0.25);
+    this->declare_parameter("fusion_range_min", 0.05);
+    this->declare_parameter("fusion_range_max", 30.0);
+    this->declare_parameter("max_scan_age", 0.0);
+    this->declare_parameter("scan_timeout", 0.5);
+    this->declare_parameter("scan_gap_factor", 1.5);
+    this->declare_parameter("watchdog_period", 0.05);
+    this->declare_parameter("nav_cancel_timeout", 1.0);
+    this->declare_parameter("flight_recorder_path", "");
+    this->declare_parameter("flight_recorder_slots", 36000);
+    this->declare_parameter("flight_recorder_ranges", false);
+    this->declare_parameter("decision_trace_path", "");
+    this->declare_parameter("decision_trace_queue", 4096);
+    this->declare_parameter("callback_budget", 0.0);
+    this->declare_parameter("scan_rate_warn_ratio", 0.8);
+    this->declare_parameter("scan_rate_error_ratio", 0.5);
+    this->declare_parameter("behavior_log_warn_size", 1000);
+    this->declare_parameter("load_governor", true);
+    this->declare_parameter("governor_degrade_ratio", 1.0);
+    this->declare_parameter("governor_recover_ratio", 0.6);
+    this->declare_parameter("governor_degrade_scans", 5);
+    this->declare_parameter("governor_recover_scans", 100);
+    this->declare_parameter("governor_sector_limit", 3);
+    this->declare_parameter("executor_type", "single_threaded");
+    this->declare_parameter("executor_threads", 0);
 }
 
-void WallTracking::get_param()
-{
-    this->get_parameter("max_linear_vel", max_linear_vel_);
-    this->get_parameter("max_angular_vel", max_angular_vel_);
-    this->get_parameter("min_angular_vel", min_angular_vel_);
-    this->get_parameter("distance_from_wall", distance_from_wall_);
-    this->get_parameter("distance_to_stop", distance_to_stop_);
-    this->get_parameter("sampling_rate", sampling_rate_);
-    this->get_parameter("kp", kp_);
-    this->get_parameter("ki", ki_);
-    this->get_parameter("kd", kd_);
-    this->get_parameter("start_deg_lateral", start_deg_lateral_);
-    this->get_parameter("end_deg_lateral", end_deg_lateral_);
-    this->get_parameter("stop_ray_th", stop_ray_th_);
-    this->get_parameter("wheel_separation", wheel_separation_);
-    this->get_parameter("distance_to_skip", distance_to_skip_);
-    this->get_parameter("open_place_distance", open_place_distance_);
-    this->get_parameter("detection_div_deg", detection_div_deg_);
-    this->get_parameter("select_angvel", select_angvel_);
-    // RCLCPP_INFO(this->get_logger(), "%d", detection_div_deg_.size());
+bool WallTracking::get_param()
+{
+    std::string err;
+    ControlParams params;
+    if(!read_control_params({}, params, err)){
+        RCLCPP_ERROR(this->get_logger(), "Invalid parameters: %s", err.c_str());
+        return false;
+    }
+    set_follower_params(params);
+    // 診断などscan以外のスレッドはpending_params_から読むので、起動時の値も入れておく
+    pending_params_.store(params);
+    applied_params_version_ = pending_params_.version();
+    this->get_parameter("scan_beam_capacity", scan_beam_capacity_);
+    this->get_parameter("deskew_scan", deskew_scan_);
+    this->get_parameter("deskew_use_odom", deskew_use_odom_);
+    this->get_parameter("realtime_cpu", realtime_cpu_);
+    this->get_parameter("realtime_priority", realtime_priority_);
+    this->get_parameter("realtime_lock_memory", realtime_lock_memory_);
+    this->get_parameter("scan_deadline", scan_deadline_);
+    this->get_parameter("scan_latest_only", scan_latest_only_);
+    this->get_parameter("cloud_input", cloud_input_);
+    this->get_parameter("cloud_min_height", cloud_slice_.min_height);
+    this->get_parameter("cloud_max_height", cloud_slice_.max_height);
+    this->get_parameter("cloud_angle_min_deg", cloud_slice_.angle_min_deg);
+    this->get_parameter("cloud_angle_max_deg", cloud_slice_.angle_max_deg);
+    this->get_parameter("cloud_angle_increment_deg", cloud_slice_.angle_increment_deg);
+    this->get_parameter("cloud_range_min", cloud_slice_.range_min);
+    this->get_parameter("cloud_range_max", cloud_slice_.range_max);
+    if(cloud_input_ && !cloud_projector_.configure(cloud_slice_, err)){
+        RCLCPP_ERROR(this->get_logger(), "Invalid parameters: %s", err.c_str());
+        return false;
+    }
+    this->get_parameter("fusion_scan_topics", fusion_scan_topics_);
+    this->get_parameter("fusion_max_skew", fusion_max_skew_);
+    if(!fusion_scan_topics_.empty()){
+        // センサごとに[x, y, yaw_deg]を並べる
+        std::vector<double> poses = this->get_parameter("fusion_sensor_poses").as_double_array();
+        if(poses.size() != 3 * fusion_scan_topics_.size()){
+            RCLCPP_ERROR(this->get_logger(), "Invalid parameters: fusion_sensor_poses needs [x, y, yaw_deg] for each of %zu topics",
+                fusion_scan_topics_.size());
+            return false;
+        }
+        std::vector<SensorPose> sensor_poses(fusion_scan_topics_.size());
+        for(std::size_t i = 0; i < sensor_poses.size(); ++i){
+            sensor_poses[i].x = poses[3 * i];
+            sensor_poses[i].y = poses[3 * i + 1];
+            sensor_poses[i].yaw_deg = poses[3 * i + 2];
+        }
+        VirtualScanConfig virtual_scan;
+        this->get_parameter("fusion_angle_min_deg", virtual_scan.angle_min_deg);
+        this->get_parameter("fusion_angle_max_deg", virtual_scan.angle_max_deg);
+        this->get_parameter("fusion_angle_increment_deg", virtual_scan.angle_increment_deg);
+        this->get_parameter("fusion_range_min", virtual_scan.range_min);
+        this->get_parameter("fusion_range_max", virtual_scan.range_max);
+        if(!scan_fuser_.configure(virtual_scan, sensor_poses,
+            static_cast<std::size_t>(std::max(scan_beam_capacity_, 0)), err)){
+            RCLCPP_ERROR(this->get_logger(), "Invalid parameters: %s", err.c_str());
+            return false;
+        }
+    }
+    this->get_parameter("max_scan_age", max_scan_age_);
+    this->get_parameter("scan_timeout", scan_timeout_);
+    this->get_parameter("scan_gap_factor", scan_gap_factor_);
+    this->get_parameter("watchdog_period", watchdog_period_);
+    this->get_parameter("nav_cancel_timeout", nav_cancel_timeout_);
+    this->get_parameter("flight_recorder_path", flight_recorder_path_);
+    this->get_parameter("flight_recorder_slots", flight_recorder_slots_);
+    this->get_parameter("flight_recorder_ranges", flight_recorder_ranges_);
+    this->get_parameter("decision_trace_path", decision_trace_path_);
+    this->get_parameter("decision_trace_queue", decision_trace_queue_);
+    this->get_parameter("callback_budget", callback_budget_);
+    this->get_parameter("scan_rate_warn_ratio", scan_rate_warn_ratio_);
+    this->get_parameter("scan_rate_error_ratio", scan_rate_error_ratio_);
+    this->get_parameter("behavior_log_warn_size", behavior_log_warn_size_);
+    this->get_parameter("load_governor", load_governor_enabled_);
+    this->get_parameter("governor_degrade_ratio", governor_config_.degrade_ratio);
+    this->get_parameter("governor_recover_ratio", governor_config_.recover_ratio);
+    this->get_parameter("governor_degrade_scans", governor_config_.degrade_scans);
+    this->get_parameter("governor_recover_scans", governor_config_.recover_scans);
+    this->get_parameter("governor_sector_limit", governor_sector_limit_);
+    if(governor_config_.recover_ratio >= governor_config_.degrade_ratio){
+        RCLCPP_ERROR(this->get_logger(), "Invalid parameters: governor_recover_ratio must be below governor_degrade_ratio");
+        return false;
+    }
+    // RCLCPP_INFO(this->get_logger(), "%d", params.sector_num);
+    return true;
+}
+
+void WallTracking::init_callback_group()
+{
+    // リアルタイムモードではscanのコールバックグループを専用スレッドのexecutorで回す
+    scan_cb_group_ = this->create_callback_group(
+        rclcpp::CallbackGroupType::MutuallyExclusive, !realtime_mode_);
+    // GNSS・オドメトリはフラグを書き込むだけなので並列に実行してよい
+    sensor_cb_group_ = this->create_callback_group(rclcpp::CallbackGroupType::Reentrant);
+    // アクションとゴール関連のコールバックは直列に実行する。
+    // behavior_stamped_array_とnav_goal_msgs_はgoal_workerからも触るのでbehavior_mutex_で守る
+    action_cb_group_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
 }
 
 void WallTracking::init_sub()
 {
-    scan_sub_ = this->create_subscription<sensor_msgs::msg::LaserScan>(
-        "scan", rclcpp::QoS(10),
-        std::bind(&WallTracking::scan_callback, this, std::placeholders::_1));
+    rclcpp::SubscriptionOptions scan_options, sensor_options, action_options;
+    scan_options.callback_group = scan_cb_group_;
+    sensor_options.callback_group = sensor_cb_group_;
+    action_options.callback_group = action_cb_group_;
+    // 最新のスキャンだけを処理するモードでは、処理が遅れても古いスキャンを溜めない
+    rclcpp::QoS scan_qos = scan_latest_only_ ? rclcpp::SensorDataQoS().keep_last(1) : rclcpp::QoS(10);
+    scan_options.event_callbacks.message_lost_callback =
+        [this](rclcpp::QOSMessageLostInfo & info) { lost_scans_ += info.total_count_change; };
+    // 3D LiDARの場合はpointcloud_to_laserscanを挟まずに点群を直接購読する
+    auto create_scan_sub = [&]() {
+        if(!fusion_scan_topics_.empty()){
+            // 複数LiDARは1つの仮想スキャンに統合する。先頭のトピックの受信で統合を行う
+            fusion_subs_.clear();
+            for(std::size_t i = 0; i < fusion_scan_topics_.size(); ++i){
+                fusion_subs_.push_back(this->create_subscription<sensor_msgs::msg::LaserScan>(
+                    fusion_scan_topics_[i], scan_qos,
+                    [this, i](sensor_msgs::msg::LaserScan::ConstSharedPtr msg) { fusion_scan_callback(msg, i); },
+                    scan_options));
+            }
+        }else if(cloud_input_){
+            cloud_sub_ = this->create_subscription<sensor_msgs::msg::PointCloud2>(
+                "points", scan_qos,
+                std::bind(&WallTracking::cloud_callback, this, std::placeholders::_1), scan_options);
+        }else{
+            scan_sub_ = this->create_subscription<sensor_msgs::msg::LaserScan>(
+                "scan", scan_qos,
+                std::bind(&WallTracking::scan_callback, this, std::placeholders::_1), scan_options);
+        }
+    };
+    try {
+        create_scan_sub();
+    } catch (const rclcpp::UnsupportedEventTypeException &) {
+        RCLCPP_WARN(this->get_logger(), "message lost event is not supported, lost scans are not counted");
+        scan_options.event_callbacks.message_lost_callback = nullptr;
+        create_scan_sub();
+    }
     gnss_sub_ = this->create_subscription<sensor_msgs::msg::NavSatFix>(
         "gnss/fix", rclcpp::QoS(10),
-        std::bind(&WallTracking::gnss_callback, this, std::placeholders::_1));
+        std::bind(&WallTracking::gnss_callback, this, std::placeholders::_1), sensor_options);
     gnss_pose_with_covariance_sub_ = this->create_subscription<geometry_msgs::msg::PoseWithCovarianceStamped>(
         "gnss_pose_with_covariance", rclcpp::QoS(10),
-        std::bind(&WallTracking::gnss_pose_with_covariance_callback, this, std::placeholders::_1));
+        std::bind(&WallTracking::gnss_pose_with_covariance_callback, this, std::placeholders::_1), sensor_options);
     goal_pose_sub_ = this->create_subscription<geometry_msgs::msg::PoseStamped>(
         "goal_pose", rclcpp::QoS(1),
-        std::bind(&WallTracking::goal_pose_callback, this, std::placeholders::_1));
+        std::bind(&WallTracking::goal_pose_callback, this, std::placeholders::_1), action_options);
+    if(deskew_scan_ && deskew_use_odom_){
+        odom_sub_ = this->create_subscription<nav_msgs::msg::Odometry>(
+            "odom", rclcpp::QoS(10),
+            std::bind(&WallTracking::odom_callback, this, std::placeholders::_1), sensor_options);
+    }
 }
 
 void WallTracking::init_pub()
 {
+    // ライフサイクルパブリッシャーはactivate/deactivateで出力を切り替えるだけで再確保しない
     cmd_vel_pub_ = this->create_publisher<geometry_msgs::msg::Twist>("cmd_vel", rclcpp::QoS(10));
-    open_place_arrived_pub_ = this->create_publisher<std_msgs::msg::Bool>("open_place_arrived", rclcpp::QoS(10));
-    open_place_detection_pub_ = this->create_publisher<std_msgs::msg::String>("open_place_detection", rclcpp::QoS(10));
+    // 状態トピックは変化したときだけ出すので、後から購読したノードにも最新の値が届くようにする
+    open_place_arrived_pub_ = this->create_publisher<std_msgs::msg::Bool>(
+        "open_place_arrived", rclcpp::QoS(1).transient_local());
+    open_place_detection_pub_ = this->create_publisher<std_msgs::msg::String>(
+        "open_place_detection", rclcpp::QoS(1).transient_local());
     behavior_stamped_array_pub_ = this->create_publisher<wall_tracking_msgs::msg::BehaviorStamped>("behavior_stamped", rclcpp::QoS(10));
+    handover_latency_pub_ = this->create_publisher<std_msgs::msg::Float32>("handover_latency", rclcpp::QoS(10));
 }
 
 void WallTracking::init_action()
@@ -101,10 +562,12 @@ void WallTracking::init_action()
         this, "wall_tracking",
         std::bind(&WallTracking::handle_goal, this, std::placeholders::_1, std::placeholders::_2),
         std::bind(&WallTracking::handle_cancel, this, std::placeholders::_1),
-        std::bind(&WallTracking::handle_accepted, this, std::placeholders::_1));
+        std::bind(&WallTracking::handle_accepted, this, std::placeholders::_1),
+        rcl_action_server_get_default_options(), action_cb_group_);
     navigation_action_client_ = rclcpp_action::create_client<NavigateToPose>(
         this,
-        "navigate_to_pose");
+        "navigate_to_pose",
+        action_cb_group_);
     nav_send_goal_options_ = rclcpp_action::Client<NavigateToPose>::SendGoalOptions();
     using namespace std::placeholders;
     nav_send_goal_options_.goal_response_callback = std::bind(
@@ -116,6 +579,24 @@ void WallTracking::init_action()
         std::placeholders::_1, std::placeholders::_2);
 }
 
+void WallTracking::init_timer()
+{
+    // scanと同じコールバックグループにしてウォッチドッグの状態を排他的に扱う
+    // ノードのクロックで回すので、sim timeでは再生速度に合わせて周期が伸縮する
+    watchdog_timer_ = rclcpp::create_timer(
+        this, this->get_clock(), rclcpp::Duration::from_seconds(watchdog_period_),
+        std::bind(&WallTracking::watchdog_callback, this), scan_cb_group_);
+}
+
+void WallTracking::init_diagnostics()
+{
+    // /diagnosticsの周期はdiagnostic_updater.periodパラメータで変えられる
+    diagnostic_updater_ = std::make_unique<diagnostic_updater::Updater>(this);
+    diagnostic_updater_->setHardwareID(this->get_name());
+    diagnostic_updater_->add("scan pipeline", this, &WallTracking::diagnose_scan);
+    diagnostic_updater_->add("behavior", this, &WallTracking::diagnose_behavior);
+}
+
 void WallTracking::goalResponceCallback(const std::shared_ptr<GoalHandleNavigateToPose> & goal_handle)
 {
     if(!goal_handle){
@@ -155,78 +636,470 @@ void WallTracking::resultCallback(const GoalHandleNavigateToPose::WrappedResult
 
 void WallTracking::behaviorStampedPub(void)
 {
-    rclcpp::Rate pub_rate(1);
-    for(auto &b: behavior_stamped_array_){
+    // 送信中にgoal_workerを待たせないよう、記録を取り出してからロックの外で出す
+    std::vector<wall_tracking_msgs::msg::BehaviorStamped> behaviors;
+    {
+        std::lock_guard<std::mutex> lock(behavior_mutex_);
+        behaviors.swap(behavior_stamped_array_);
+        behavior_log_size_ = 0;
+    }
+    // 購読者がいないか過負荷なら1件ごとの待ち時間も含めて省く
+    if(!debug_outputs() || !hasSubscribers(behavior_stamped_array_pub_)) return;
+    for(auto &b: behaviors){
         wall_tracking_msgs::msg::BehaviorStamped tmp;
         tmp.behavior_name = b.behavior_name;
         tmp.stamp = b.stamp;
         behavior_stamped_array_pub_->publish(tmp);
-        pub_rate.sleep();
+        // ノードのクロックで1 s空けるが、/clockが止まっても実時間で1 sを超えたら次へ進む
+        rclcpp::Time until = this->now() + rclcpp::Duration(1s);
+        auto steady_until = std::chrono::steady_clock::now() + 1s;
+        while(rclcpp::ok() && this->now() < until && std::chrono::steady_clock::now() < steady_until){
+            std::this_thread::sleep_for(10ms);
+        }
     }
-    behavior_stamped_array_.clear();
 }
 
 void WallTracking::init_variable()
 {
-    ei_ = 0.0;
-    fwc_deg_ = RAD2DEG(atan2f(-wheel_separation_ / 2, distance_to_stop_));
-    float y = distance_from_wall_, x = distance_to_skip_;
-    x += distance_from_wall_ / tan(DEG2RAD(start_deg_lateral_));
-    flw_deg_ = RAD2DEG(atan2(y, x));
-    open_place_ = false;
+    follower_.reset();
     outdoor_ = false;
+    open_place_arrived_published_ = false;
     init_scan_data_ = false;
-    vel_open_place_ = max_linear_vel_ / 3;
-    cmd_vel_ = max_linear_vel_;
     wall_tracking_flg_ = false;
-    pre_e_ = 0.;
     gnss_nan_ = true;
+    recieved_nav_goal_ = false;
+    last_handover_latency_ = 0.;
+    odom_received_ = false;
+    odom_linear_x_ = 0.;
+    odom_angular_z_ = 0.;
+    last_cmd_linear_x_ = 0.;
+    last_cmd_angular_z_ = 0.;
+    turn_hold_until_ns_ = 0;
+    // 締め切りが未設定ならLiDARの周期を使う
+    if(scan_deadline_ <= 0.) scan_deadline_ = follower_.params().sampling_rate;
+    scan_count_ = 0;
+    deadline_misses_ = 0;
+    last_scan_duration_ = 0.;
+    max_scan_duration_ = 0.;
+    dropped_scans_ = 0;
+    last_scan_age_ = 0.;
+    late_scans_ = 0;
+    lost_scans_ = 0;
+    // 予算が未設定ならスキャンの締め切りを使う
+    if(callback_budget_ <= 0.) callback_budget_ = scan_deadline_;
+    callback_durations_.takeSummary();
+    // 予算を超えたら任意の処理から順に止める
+    governor_config_.budget = load_governor_enabled_ ? callback_budget_ : 0.;
+    load_governor_.configure(governor_config_);
+    load_level_ = static_cast<uint8_t>(load_governor_.level());
+    load_level_changes_ = 0;
+    {
+        std::lock_guard<std::mutex> lock(behavior_mutex_);
+        behavior_log_size_ = behavior_stamped_array_.size();
+    }
+    last_diagnose_time_ = std::chrono::steady_clock::now();
+    diag_scan_count_ = diag_dropped_scans_ = diag_late_scans_ = diag_lost_scans_ = diag_deadline_misses_ = 0;
+    scan_watchdog_ = std::make_unique<ScanWatchdog>(scan_timeout_, scan_gap_factor_);
+    // スキャン処理中に確保が起きないよう、バッファはここで確保しておく
+    scan_data_ = std::make_shared<ScanData>(static_cast<std::size_t>(std::max(scan_beam_capacity_, 0)));
+}
+
+bool WallTracking::realtimeMode() const { return realtime_mode_; }
+
+bool WallTracking::debug_outputs() const
+{
+    // スキャン以外のスレッドからも読めるよう、ガバナ本体でなく公開済みのレベルを見る
+    return static_cast<LoadLevel>(load_level_.load()) < LoadLevel::NO_DEBUG;
+}
+
+ScanFeatures WallTracking::latestScanFeatures() const { return latest_scan_features_.load(); }
+
+rclcpp::CallbackGroup::SharedPtr WallTracking::scanCallbackGroup() const { return scan_cb_group_; }
+
+std::string WallTracking::executorType() const { return executor_type_; }
+
+std::size_t WallTracking::executorThreads() const { return static_cast<std::size_t>(std::max(executor_threads_, 0)); }
+
+void WallTracking::configureRealtimeThread()
+{
+    std::string err;
+    if(realtime_cpu_ >= 0){
+        if(setThreadAffinity(realtime_cpu_, err)) RCLCPP_INFO(this->get_logger(), "Realtime: pinned scan thread to cpu %d", realtime_cpu_);
+        else RCLCPP_WARN(this->get_logger(), "Realtime: failed to set cpu affinity (%s), continuing unpinned", err.c_str());
+    }
+    if(setThreadFifoPriority(realtime_priority_, err)) RCLCPP_INFO(this->get_logger(), "Realtime: SCHED_FIFO priority %d", realtime_priority_);
+    else RCLCPP_WARN(this->get_logger(), "Realtime: failed to set SCHED_FIFO (%s), continuing with default scheduling", err.c_str());
+    if(realtime_lock_memory_){
+        if(lockProcessMemory(64 * 1024 * 1024, err)) RCLCPP_INFO(this->get_logger(), "Realtime: locked process memory");
+        else RCLCPP_WARN(this->get_logger(), "Realtime: mlockall failed (%s), memory may be paged", err.c_str());
+        prefaultStack(512 * 1024);
+    }
 }
 
 void WallTracking::pub_cmd_vel(float linear_x, float angular_z)
 {
-    cmd_vel_msg_.linear.x = std::min(linear_x, max_linear_vel_);
-    cmd_vel_msg_.angular.z = std::max(std::min(angular_z, max_angular_vel_), min_angular_vel_);
-    cmd_vel_pub_->publish(cmd_vel_msg_);
+    // scan・ゴール・ライフサイクルの各スレッドから呼ばれるので、メッセージは毎回ローカルに作る
+    geometry_msgs::msg::Twist msg;
+    msg.linear.x = std::min(linear_x, max_linear_vel_.load());
+    msg.angular.z = std::max(std::min(angular_z, max_angular_vel_.load()), min_angular_vel_.load());
+    last_cmd_linear_x_ = static_cast<float>(msg.linear.x);
+    last_cmd_angular_z_ = static_cast<float>(msg.angular.z);
+    WALL_TRACKING_TRACEPOINT(cmd_vel_publish, static_cast<const void *>(cmd_vel_pub_.get()),
+        static_cast<float>(msg.linear.x), static_cast<float>(msg.angular.z));
+    cmd_vel_pub_->publish(msg);
+}
+
+void WallTracking::scan_callback(sensor_msgs::msg::LaserScan::ConstSharedPtr msg)
+{
+    CallbackGate::Guard guard(scan_gate_);
+    if(!guard) return;
+    auto start = std::chrono::steady_clock::now();
+    rclcpp::Time stamp(msg->header.stamp, this->get_clock()->get_clock_type());
+    if(!accept_scan(stamp)) return;
+    // intensitiesは使わないのでrangesだけをコピーせずに参照する
+    scan_process(stamp, RangeView(msg->ranges), toScanGeometry(*msg));
+    finish_scan(start);
+}
+
+void WallTracking::cloud_callback(sensor_msgs::msg::PointCloud2::ConstSharedPtr msg)
+{
+    CallbackGate::Guard guard(scan_gate_);
+    if(!guard) return;
+    auto start = std::chrono::steady_clock::now();
+    rclcpp::Time stamp(msg->header.stamp, this->get_clock()->get_clock_type());
+    if(!accept_scan(stamp)) return;
+    CloudLayout layout;
+    if(!toCloudLayout(*msg, layout) || !cloud_projector_.project(layout)){
+        RCLCPP_ERROR_THROTTLE(this->get_logger(), *this->get_clock(), 1000,
+            "Unsupported point cloud: x, y, z must be FLOAT32 in host byte order");
+        return;
+    }
+    scan_process(stamp, cloud_projector_.ranges(), cloud_projector_.geometry());
+    finish_scan(start);
+}
+
+void WallTracking::fusion_scan_callback(sensor_msgs::msg::LaserScan::ConstSharedPtr msg, std::size_t sensor)
+{
+    CallbackGate::Guard guard(scan_gate_);
+    if(!guard) return;
+    if(!active_) return;
+    auto start = std::chrono::steady_clock::now();
+    rclcpp::Time stamp(msg->header.stamp, this->get_clock()->get_clock_type());
+    if(!scan_fuser_.update(sensor, stamp.nanoseconds(), RangeView(msg->ranges), toScanGeometry(*msg))){
+        RCLCPP_ERROR_THROTTLE(this->get_logger(), *this->get_clock(), 1000,
+            "%s has %zu beams, more than scan_beam_capacity (%d)",
+            fusion_scan_topics_[sensor].c_str(), msg->ranges.size(), scan_beam_capacity_);
+        return;
+    }
+    // どのセンサが届いても合成するが、基準時刻は常に最新のスキャンに合わせる。
+    // 最新より古いスキャンは取り込むだけにして、次の合成で時刻を合わせて使う
+    if(stamp.nanoseconds() < scan_fuser_.newestStamp() || !accept_scan(stamp)) return;
+    bool use_odom = deskew_use_odom_ && odom_received_;
+    float linear_x = use_odom ? odom_linear_x_.load() : last_cmd_linear_x_.load();
+    float angular_z = use_odom ? odom_angular_z_.load() : last_cmd_angular_z_.load();
+    scan_fuser_.fuse(stamp.nanoseconds(), static_cast<int64_t>(fusion_max_skew_ * 1e9), linear_x, angular_z);
+    scan_process(stamp, scan_fuser_.ranges(), scan_fuser_.geometry());
+    finish_scan(start);
+}
+
+bool WallTracking::accept_scan(const rclcpp::Time & stamp)
+{
+    if(!active_) return false;
+    float age = (this->now() - stamp).seconds();
+    if(max_scan_age_ > 0. && age > max_scan_age_){
+        // 古いスキャンで速度指令を出さない
+        ++dropped_scans_;
+        RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 1000,
+            "Dropped stale scan: age %.1f ms > %.1f ms (dropped: %lu, late: %lu, lost: %lu)",
+            age * 1e3, max_scan_age_ * 1e3, static_cast<unsigned long>(dropped_scans_),
+            static_cast<unsigned long>(late_scans_), static_cast<unsigned long>(lost_scans_));
+        // 直前の指令で走り続けないよう、壁沿い中は止めておく
+        if(wall_tracking_flg_) pub_cmd_vel(0., 0.);
+        return false;
+    }
+    if(age > follower_.params().sampling_rate) ++late_scans_;
+    last_scan_age_ = age;
+    double now_sec = this->now().seconds();
+    if(scan_watchdog_->timedOut()){
+        RCLCPP_INFO(this->get_logger(), "Scan resumed after %.2f s (rate: %.1f Hz, max gap: %.2f s, gaps: %lu)",
+            scan_watchdog_->timeSinceLastScan(now_sec), scan_watchdog_->scanRate(),
+            scan_watchdog_->maxInterval(), static_cast<unsigned long>(scan_watchdog_->gapCount()));
+    }
+    scan_watchdog_->scanReceived(now_sec);
+    WALL_TRACKING_TRACEPOINT(scan_receive, stamp.nanoseconds(), age);
+    return true;
+}
+
+void WallTracking::finish_scan(std::chrono::steady_clock::time_point start)
+{
+    last_scan_duration_ = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    max_scan_duration_ = std::max(max_scan_duration_, last_scan_duration_);
+    ++scan_count_;
+    callback_durations_.record(last_scan_duration_);
+    flight_record_.scan_age = last_scan_age_;
+    flight_record_.scan_duration = last_scan_duration_;
+    if(last_scan_duration_ > scan_deadline_){
+        flight_record_.flags |= FlightRecord::DEADLINE_MISS;
+        ++deadline_misses_;
+        RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 1000,
+            "Scan deadline missed: %.2f ms > %.2f ms (%lu / %lu scans)",
+            last_scan_duration_ * 1e3, scan_deadline_ * 1e3,
+            static_cast<unsigned long>(deadline_misses_), static_cast<unsigned long>(scan_count_));
+    }
+    bool record_ranges = flight_recorder_ranges_ && load_governor_.debugOutputs();
+    flight_recorder_.record(flight_record_, record_ranges ? scan_data_->ranges() : RangeView());
+    if(load_governor_.update(last_scan_duration_)){
+        bool degraded = static_cast<uint8_t>(load_governor_.level()) > load_level_;
+        load_level_ = static_cast<uint8_t>(load_governor_.level());
+        ++load_level_changes_;
+        if(degraded){
+            RCLCPP_WARN(this->get_logger(), "Load governor: %s (mean callback %.2f ms, budget %.2f ms)",
+                toString(load_governor_.level()), load_governor_.meanDuration() * 1e3, governor_config_.budget * 1e3);
+        }else{
+            RCLCPP_INFO(this->get_logger(), "Load governor: %s (mean callback %.2f ms, budget %.2f ms)",
+                toString(load_governor_.level()), load_governor_.meanDuration() * 1e3, governor_config_.budget * 1e3);
+        }
+    }
+}
+
+void WallTracking::record_decision(const rclcpp::Time & stamp, const Decision & decision)
+{
+    // 文字列のログの代わりに判断の中身をそのままバイナリで残す。過負荷時は止める
+    if(load_governor_.debugOutputs()) decision_trace_.push(toTraceRecord(stamp.nanoseconds(), decision));
+    FlightRecord & r = flight_record_;
+    r.action = static_cast<uint8_t>(decision.action);
+    r.flags |= FlightRecord::TRACKING;
+    if(decision.open_place) r.flags |= FlightRecord::OPEN_PLACE;
+    if(decision.gap_start) r.flags |= FlightRecord::GAP_START;
+    if(decision.gap_end) r.flags |= FlightRecord::GAP_END;
+    if(decision.front_left_wall) r.flags |= FlightRecord::FRONT_LEFT_WALL;
+    // 旋回は速度制限なしで出すので判断結果の値をそのまま残す
+    bool turn = decision.action == FollowAction::TURN;
+    r.cmd_linear_x = turn ? decision.linear_x : last_cmd_linear_x_.load();
+    r.cmd_angular_z = turn ? decision.angular_z : last_cmd_angular_z_.load();
+    r.lateral_mean = decision.lateral_mean;
+    r.front_wall_ratio = decision.front_wall_ratio;
+    r.open_place_ratio = decision.open_place_ratio;
+    r.open_place_mean = decision.open_place_mean;
+    r.pid_p = decision.pid_p;
+    r.pid_i = decision.pid_i;
+    r.pid_d = decision.pid_d;
+    r.sector_num = static_cast<uint8_t>(std::max(decision.sector_num, 0));
+    r.max_index = static_cast<int16_t>(decision.max_index);
+    std::copy(std::begin(decision.evals), std::end(decision.evals), r.evals);
 }
 
-void WallTracking::scan_callback(sensor_msgs::msg::LaserScan::ConstSharedPtr msg) 
+void WallTracking::scan_process(const rclcpp::Time & stamp, RangeView ranges, const ScanGeometry & geometry)
 {
+    apply_pending_params();
     if (!init_scan_data_) {
-        scan_data_.reset(new ScanData(msg));
         init_scan_data_ = true;
         RCLCPP_INFO(this->get_logger(), "initialized scan data");
+        if (static_cast<int>(ranges.size()) > scan_beam_capacity_) {
+            RCLCPP_WARN(this->get_logger(), "scan has %zu beams, more than scan_beam_capacity (%d)",
+                ranges.size(), scan_beam_capacity_);
+        }
+    }
+    scan_data_->dataUpdate(ranges, geometry);
+    bool deskew = deskew_scan_ && load_governor_.deskew();
+    if(deskew){
+        // オドメトリが無い場合は直前の速度指令値を使う
+        bool use_odom = deskew_use_odom_ && odom_received_;
+        float linear_x = use_odom ? odom_linear_x_.load() : last_cmd_linear_x_.load();
+        float angular_z = use_odom ? odom_angular_z_.load() : last_cmd_angular_z_.load();
+        scan_data_->deskew(linear_x, angular_z);
     }
-    scan_data_->dataUpdate(msg);
-    if(!wall_tracking_flg_) return;
-    switch (outdoor_)
+    WALL_TRACKING_TRACEPOINT(scan_data_update, stamp.nanoseconds(), static_cast<uint32_t>(ranges.size()),
+        static_cast<int>(deskew));
+    scan_features_ = ScanFeatures();
+    scan_features_.stamp_ns = stamp.nanoseconds();
+    scan_features_.outdoor = outdoor_;
+    flight_record_ = FlightRecord();
+    flight_record_.stamp_ns = scan_features_.stamp_ns;
+    flight_record_.flags = (outdoor_ ? FlightRecord::OUTDOOR : 0) | (deskew ? FlightRecord::DESKEW : 0);
+    if(!wall_tracking_flg_){
+        latest_scan_features_.store(scan_features_);
+        return;
+    }
+    if(this->now().nanoseconds() < turn_hold_until_ns_){
+        // 旋回中のスキャンは判断に使わず、出した旋回指令を保つ
+        scan_features_.tracking = true;
+        scan_features_.action = static_cast<uint8_t>(FollowAction::TURN);
+        latest_scan_features_.store(scan_features_);
+        flight_record_.action = static_cast<uint8_t>(FollowAction::TURN);
+        flight_record_.flags |= FlightRecord::TRACKING;
+        flight_record_.cmd_linear_x = last_cmd_linear_x_;
+        flight_record_.cmd_angular_z = last_cmd_angular_z_;
+        return;
+    }
+    FollowerInput input;
+    input.outdoor = outdoor_;
+    input.gnss_nan = gnss_nan_;
+    input.navigating = recieved_nav_goal_;
+    input.sector_limit = load_governor_.allSectors() ? 0 : governor_sector_limit_;
+    const Decision &decision = follower_.step(*scan_data_, input);
+    scan_features_.tracking = true;
+    scan_features_.action = static_cast<uint8_t>(decision.action);
+    scan_features_.open_place_ratio = decision.open_place_ratio;
+    scan_features_.front_wall_ratio = decision.front_wall_ratio;
+    scan_features_.open_place = decision.open_place;
+    // cmd_velを受けた側がどのスキャンからの指令か分かるよう、公開前に特徴量を出しておく
+    latest_scan_features_.store(scan_features_);
+    pub_open_place_arrived(decision.open_place);
+    switch (decision.action)
     {
-    case false:
-        open_place_ = false;
+    case FollowAction::STOP:
+        pub_cmd_vel(0., 0.);
+        break;
+    case FollowAction::TURN:
+        turn();
         break;
-    
-    case true:
-        float per, mean;
-        // float p = scan_data_->openPlaceCheck(-90., 90., open_place_distance_, per, mean);
-        scan_data_->openPlaceCheck(-90., 90., open_place_distance_, per, mean);
-        open_place_ = !open_place_ ? (per >= 0.7) : per >= 0.4;
-        if(gnss_nan_) open_place_ = false;
-        cmd_vel_ = !open_place_ ? max_linear_vel_ : vel_open_place_;
-    }
-    pub_open_place_arrived(open_place_);
-    if(wall_tracking_flg_ && recieved_nav_goal_) navigateOpenPlace();
-    else pub_cmd_vel(0., 0.);
+    default:
+        pub_cmd_vel(decision.linear_x, decision.angular_z);
+        pub_open_place_detection(decision.action == FollowAction::OPEN_PLACE ? "Detect open place" : "Indoor");
+        break;
+    }
+    record_decision(stamp, decision);
     // RCLCPP_INFO(this->get_logger(), "update scan data");
 }
 
+void WallTracking::watchdog_callback()
+{
+    CallbackGate::Guard guard(scan_gate_);
+    if(!guard) return;
+    if(!active_) return;
+    double now_sec = this->now().seconds();
+    if(scan_watchdog_->check(now_sec)){
+        RCLCPP_ERROR(this->get_logger(), "No scan for %.2f s (timeout %.2f s, rate: %.1f Hz, gaps: %lu), stopping",
+            scan_watchdog_->timeSinceLastScan(now_sec), scan_timeout_, scan_watchdog_->scanRate(),
+            static_cast<unsigned long>(scan_watchdog_->gapCount()));
+    }
+    // スキャンが途絶えている間は停止指令を出し続ける
+    if(scan_watchdog_->timedOut() && wall_tracking_flg_) pub_cmd_vel(0., 0.);
+}
+
+void WallTracking::diagnose_scan(diagnostic_updater::DiagnosticStatusWrapper & stat)
+{
+    using diagnostic_msgs::msg::DiagnosticStatus;
+    if(!active_){
+        stat.summary(DiagnosticStatus::OK, "Inactive");
+        return;
+    }
+    // 前回の診断からの増分で評価する
+    auto now = std::chrono::steady_clock::now();
+    double window = std::chrono::duration<double>(now - last_diagnose_time_).count();
+    last_diagnose_time_ = now;
+    auto delta = [](const std::atomic<uint64_t> & total, uint64_t & last) {
+        uint64_t value = total.load();
+        uint64_t d = value - last;
+        last = value;
+        return d;
+    };
+    uint64_t scans = delta(scan_count_, diag_scan_count_);
+    uint64_t dropped = delta(dropped_scans_, diag_dropped_scans_);
+    uint64_t late = delta(late_scans_, diag_late_scans_);
+    uint64_t lost = delta(lost_scans_, diag_lost_scans_);
+    uint64_t misses = delta(deadline_misses_, diag_deadline_misses_);
+    DurationSummary durations = callback_durations_.takeSummary();
+    // follower_はscanのスレッド専用なので、パラメータはSeqLockから読む
+    float sampling_rate = pending_params_.load().sampling_rate;
+    double expected_rate = sampling_rate > 0. ? 1. / sampling_rate : 0.;
+    double rate = window > 0. ? scans / window : 0.;
+
+    stat.summary(DiagnosticStatus::OK, "OK");
+    if(rate < expected_rate * scan_rate_error_ratio_){
+        stat.mergeSummary(DiagnosticStatus::ERROR, "Scan rate too low");
+    }else if(rate < expected_rate * scan_rate_warn_ratio_){
+        stat.mergeSummary(DiagnosticStatus::WARN, "Scan rate low");
+    }
+    if(durations.count > 0 && durations.p50 > callback_budget_){
+        stat.mergeSummary(DiagnosticStatus::ERROR, "Scan callback over budget");
+    }else if(durations.count > 0 && durations.p99 > callback_budget_){
+        stat.mergeSummary(DiagnosticStatus::WARN, "Scan callback over budget");
+    }
+    if(dropped > 0 || lost > 0) stat.mergeSummary(DiagnosticStatus::WARN, "Scans dropped");
+    LoadLevel load_level = static_cast<LoadLevel>(load_level_.load());
+    if(load_level != LoadLevel::FULL){
+        stat.mergeSummary(DiagnosticStatus::WARN, std::string("Degraded: ") + toString(load_level));
+    }
+
+    stat.addf("Scan rate [Hz]", "%.1f", rate);
+    stat.addf("Expected scan rate [Hz]", "%.1f", expected_rate);
+    stat.addf("Callback p50 [ms]", "%.3f", durations.p50 * 1e3);
+    stat.addf("Callback p90 [ms]", "%.3f", durations.p90 * 1e3);
+    stat.addf("Callback p99 [ms]", "%.3f", durations.p99 * 1e3);
+    stat.addf("Callback max [ms]", "%.3f", durations.max * 1e3);
+    stat.addf("Callback budget [ms]", "%.3f", callback_budget_ * 1e3);
+    stat.add("Scans", scans);
+    stat.add("Deadline misses", misses);
+    stat.add("Dropped scans", dropped);
+    stat.add("Late scans", late);
+    stat.add("Lost scans", lost);
+    stat.add("Dropped scans (total)", dropped_scans_.load());
+    stat.add("Lost scans (total)", lost_scans_.load());
+    stat.add("Load level", toString(load_level));
+    stat.add("Load level changes", load_level_changes_.load());
+}
+
+void WallTracking::diagnose_behavior(diagnostic_updater::DiagnosticStatusWrapper & stat)
+{
+    using diagnostic_msgs::msg::DiagnosticStatus;
+    ScanFeatures features = latest_scan_features_.load();
+    std::string mode = "idle";
+    if(wall_tracking_flg_ && features.tracking){
+        switch(static_cast<FollowAction>(features.action))
+        {
+        case FollowAction::STOP:
+            mode = "stopped";
+            break;
+        case FollowAction::TURN:
+            mode = "turning";
+            break;
+        case FollowAction::OPEN_PLACE:
+            mode = "open place";
+            break;
+        default:
+            mode = features.open_place ? "open place" : features.outdoor ? "outdoor" : "indoor";
+            break;
+        }
+    }
+    int goal_threads = goal_worker_thread_.joinable() ? 1 : 0;
+    bool goal_pending;
+    {
+        std::lock_guard<std::mutex> lock(goal_mutex_);
+        goal_pending = pending_goal_ != nullptr;
+    }
+    std::size_t behavior_log_size = behavior_log_size_;
+
+    stat.summary(DiagnosticStatus::OK, mode);
+    if(goal_threads == 0) stat.mergeSummary(DiagnosticStatus::ERROR, "Goal worker not running");
+    if(static_cast<int>(behavior_log_size) > behavior_log_warn_size_){
+        stat.mergeSummary(DiagnosticStatus::WARN, "Behavior log growing");
+    }
+
+    stat.add("Mode", mode);
+    stat.add("Wall tracking", wall_tracking_flg_.load());
+    stat.add("Goal threads", goal_threads);
+    stat.add("Goal active", goal_active_.load());
+    stat.add("Goal pending", goal_pending);
+    stat.add("Behavior log size", behavior_log_size);
+    stat.addf("Handover latency [ms]", "%.1f", last_handover_latency_ * 1e3);
+}
+
 void WallTracking::goal_pose_callback(geometry_msgs::msg::PoseStamped::ConstSharedPtr msg)
 {
-    nav_goal_msgs_.pose = *msg;
-    behavior_stamped_array_.clear();
+    nav2_msgs::action::NavigateToPose::Goal nav_goal;
+    {
+        std::lock_guard<std::mutex> lock(behavior_mutex_);
+        nav_goal_msgs_.pose = *msg;
+        nav_goal = nav_goal_msgs_;
+        behavior_stamped_array_.clear();
+        behavior_log_size_ = 0;
+    }
     addBehaviorStamedArray("Navigation Start");
     recieved_nav_goal_ = true;
-    RCLCPP_INFO(this->get_logger(), "Recieved nav goal: %d", recieved_nav_goal_);
-	if(!wall_tracking_flg_) navigation_action_client_->async_send_goal(nav_goal_msgs_, nav_send_goal_options_);
+    RCLCPP_INFO(this->get_logger(), "Recieved nav goal: %d", recieved_nav_goal_.load());
+	if(!wall_tracking_flg_) navigation_action_client_->async_send_goal(nav_goal, nav_send_goal_options_);
 }
 
 void WallTracking::gnss_callback(sensor_msgs::msg::NavSatFix::ConstSharedPtr msg)
@@ -235,19 +1108,17 @@ void WallTracking::gnss_callback(sensor_msgs::msg::NavSatFix::ConstSharedPtr msg
     // RCLCPP_INFO(this->get_logger(), "outdoor: %d", outdoor_);
 }
 
-void  WallTracking::gnss_pose_with_covariance_callback(geometry_msgs::msg::PoseWithCovarianceStamped::ConstSharedPtr msg)
+void WallTracking::odom_callback(nav_msgs::msg::Odometry::ConstSharedPtr msg)
 {
-    if(std::isnan(msg->pose.pose.position.x) && std::isnan(msg->pose.pose.position.y)) gnss_nan_ = true;
-    else gnss_nan_ = false;
+    odom_linear_x_ = msg->twist.twist.linear.x;
+    odom_angular_z_ = msg->twist.twist.angular.z;
+    odom_received_ = true;
 }
 
-float WallTracking::lateral_pid_control(float input)
+void  WallTracking::gnss_pose_with_covariance_callback(geometry_msgs::msg::PoseWithCovarianceStamped::ConstSharedPtr msg)
 {
-    float e = input - distance_from_wall_;
-    ei_ += e * sampling_rate_;
-    float ed = (e - pre_e_) / sampling_rate_;
-    pre_e_ = e;
-    return e * kp_ + ei_ * ki_ + ed * kd_;
+    if(std::isnan(msg->pose.pose.position.x) && std::isnan(msg->pose.pose.position.y)) gnss_nan_ = true;
+    else gnss_nan_ = false;
 }
 
 void WallTracking::turn()
@@ -255,66 +1126,14 @@ void WallTracking::turn()
     geometry_msgs::msg::Twist msg;
     msg.linear.x = 0.0;
     msg.angular.z = DEG2RAD(-45);
+    WALL_TRACKING_TRACEPOINT(cmd_vel_publish, static_cast<const void *>(cmd_vel_pub_.get()),
+        static_cast<float>(msg.linear.x), static_cast<float>(msg.angular.z));
     cmd_vel_pub_->publish(msg);
-    rclcpp::sleep_for(100ms);
-}
-
-void WallTracking::wallTracking()
-{
-    // RCLCPP_INFO(this->get_logger(), "wall tracking");
-    float gap_th = distance_from_wall_;
-    bool gap_start = scan_data_->conflictCheck(start_deg_lateral_, gap_th);
-    bool gap_end = scan_data_->conflictCheck(90., gap_th);
-    bool front_left_wall = scan_data_->thresholdCheck(flw_deg_, 1.91);
-    if ((gap_start || gap_end) && !front_left_wall &&
-        !scan_data_->noiseCheck(flw_deg_)) {
-        pub_cmd_vel(cmd_vel_, 0.0);
-        // RCLCPP_INFO(get_logger(), "skip");
-    } else {
-        double lateral_mean = scan_data_->leftWallCheck(start_deg_lateral_, end_deg_lateral_);
-        double angular_z = lateral_pid_control(lateral_mean);
-        pub_cmd_vel(cmd_vel_, angular_z);
-        // RCLCPP_INFO(get_logger(), "range: %lf", lateral_mean);
-    }
-}
-
-void WallTracking::navigateOpenPlace() 
-{
-    float front_wall_check = scan_data_->frontWallCheck(fwc_deg_, distance_to_stop_);
-    std::string detection_res = "Indoor";
-    if (front_wall_check >= stop_ray_th_) turn();
-    else{
-        switch (outdoor_)
-        {
-            case false:
-                wallTracking();
-            break;
-            case true:
-                int div_num = select_angvel_.size(), j = 0;
-                std::vector<float> evals(div_num+1, 0.), means(div_num+1, 0.);
-                float per, mean;
-                int det_div_num = detection_div_deg_.size();
-                for(int i=0; i<det_div_num; i+=2){
-                    // float res = scan_data_->openPlaceCheck(detection_div_deg_[i], detection_div_deg_[i+1], open_place_distance_, per, mean);
-                    scan_data_->openPlaceCheck(detection_div_deg_[i], detection_div_deg_[i+1], open_place_distance_, per, mean);
-                    evals[j] = per < 0.7 ? -1. : per;
-                    means[j] = mean;
-                    // RCLCPP_INFO(this->get_logger(), "Range %d : eval=%lf, mean=%lf", j+1, evals[j], means[j]);
-                    ++j;
-                }
-                auto max_iter = std::max_element(evals.begin(), evals.end());
-                int max_index = std::distance(evals.begin(), max_iter);
-                if(max_index != div_num){
-                    pub_cmd_vel(cmd_vel_, select_angvel_[max_index]);
-                    detection_res = "Detect open place";
-                } else{
-                    wallTracking();
-                }
-                // RCLCPP_INFO(this->get_logger(), "1: %f 2: %f, 3:%f, 4: %f, max i: %d", evals[0], evals[1], evals[2], evals[3], max_index);
-            break;
-        }
-        pub_open_place_detection(detection_res);
-    }
+    last_cmd_linear_x_ = static_cast<float>(msg.linear.x);
+    last_cmd_angular_z_ = static_cast<float>(msg.angular.z);
+    // コールバック内で眠ると/clockが止まったときscan_gate_を握ったまま戻らないので、
+    // 旋回を保つ間はノードのクロックで締め切りまでスキャンを読み飛ばす
+    turn_hold_until_ns_ = (this->now() + rclcpp::Duration(100ms)).nanoseconds();
 }
 
 void WallTracking::addBehaviorStamedArray(std::string behavior_name)
@@ -322,18 +1141,24 @@ void WallTracking::addBehaviorStamedArray(std::string behavior_name)
     wall_tracking_msgs::msg::BehaviorStamped tmp_behavior_stamped;
     tmp_behavior_stamped.behavior_name = behavior_name;
     tmp_behavior_stamped.stamp = now();
+    std::lock_guard<std::mutex> lock(behavior_mutex_);
     behavior_stamped_array_.push_back(tmp_behavior_stamped);
+    behavior_log_size_ = behavior_stamped_array_.size();
     // RCLCPP_INFO(this->get_logger(), "Num of behavior stamped array: %ld", behavior_stamped_array_.size());
 }
 
 void WallTracking::pub_open_place_arrived(bool open_place_arrived)
 {
+    if(open_place_arrived_published_ && open_place_arrived_msg_.data == open_place_arrived) return;
     open_place_arrived_msg_.data = open_place_arrived;
     open_place_arrived_pub_->publish(open_place_arrived_msg_);
+    open_place_arrived_published_ = true;
 }
 
-void WallTracking::pub_open_place_detection(std::string open_place_detection)
+void WallTracking::pub_open_place_detection(const char * open_place_detection)
 {
+    // 比較だけなら文字列の確保は起きない
+    if(open_place_detection_msg_.data == open_place_detection) return;
     open_place_detection_msg_.data = open_place_detection;
     open_place_detection_pub_->publish(open_place_detection_msg_);
 }
@@ -342,6 +1167,10 @@ rclcpp_action::GoalResponse WallTracking::handle_goal(
     [[maybe_unused]] const rclcpp_action::GoalUUID &uuid,
     [[maybe_unused]] std::shared_ptr<const WallTrackingAction::Goal> goal) 
 {
+        if(!active_){
+            RCLCPP_WARN(this->get_logger(), "Wall tracking: Rejected goal, node is not active");
+            return rclcpp_action::GoalResponse::REJECT;
+        }
         return rclcpp_action::GoalResponse::ACCEPT_AND_EXECUTE;
 }
 
@@ -356,28 +1185,89 @@ rclcpp_action::CancelResponse WallTracking::handle_cancel(
 void WallTracking::handle_accepted(
     const std::shared_ptr<GoalHandleWallTracking> goal_handle)
 {
-    std::thread{
-    std::bind(&WallTracking::execute, this, std::placeholders::_1),
-        goal_handle
-    }.detach();
+    std::lock_guard<std::mutex> lock(goal_mutex_);
+    if(pending_goal_){
+        // まだ開始していないゴールは新しいゴールで置き換える。
+        // ACCEPT_AND_EXECUTEで既にEXECUTINGなので、execute()は呼ばずにそのまま中断する
+        auto result = std::make_shared<WallTrackingAction::Result>();
+        result->get = false;
+        pending_goal_->abort(result);
+        RCLCPP_INFO(this->get_logger(), "Pending goal replaced by a new goal");
+    }
+    pending_goal_ = goal_handle;
+    if(goal_active_) preempt_requested_ = true;
+    goal_cv_.notify_all();
+}
+
+void WallTracking::goal_worker()
+{
+    while(true){
+        std::shared_ptr<GoalHandleWallTracking> goal_handle;
+        {
+            std::unique_lock<std::mutex> lock(goal_mutex_);
+            goal_cv_.wait(lock, [this]() { return goal_worker_stop_ || pending_goal_; });
+            if(goal_worker_stop_) return;
+            goal_handle = std::move(pending_goal_);
+            pending_goal_.reset();
+            preempt_requested_ = false;
+            goal_active_ = true;
+        }
+        execute(goal_handle);
+        {
+            std::lock_guard<std::mutex> lock(goal_mutex_);
+            goal_active_ = false;
+        }
+        // stop_goal()も同じ条件変数で終了を待っている
+        goal_cv_.notify_all();
+    }
 }
 
 void WallTracking::execute(
     const std::shared_ptr<GoalHandleWallTracking> goal_handle)
 {
     if(recieved_nav_goal_){
-        navigation_action_client_->async_cancel_all_goals();
+        // 引き継ぎの遅れはNav2へキャンセルを送ったときだけ測る
+        auto handover_start = std::chrono::steady_clock::now();
+        auto cancel_future = navigation_action_client_->async_cancel_all_goals();
         RCLCPP_INFO(this->get_logger(), "Send cancel navigation to server");
+        // Nav2がキャンセルを受け付けたらすぐに壁沿いを開始する
+        if(cancel_future.wait_for(std::chrono::duration<float>(nav_cancel_timeout_)) == std::future_status::ready){
+            RCLCPP_INFO(this->get_logger(), "Navigation cancel confirmed");
+        }else{
+            RCLCPP_WARN(this->get_logger(), "Navigation cancel was not confirmed within %.2f s", nav_cancel_timeout_);
+        }
+        last_handover_latency_ = std::chrono::duration<float>(std::chrono::steady_clock::now() - handover_start).count();
+        if(debug_outputs() && hasSubscribers(handover_latency_pub_)){
+            std_msgs::msg::Float32 handover_latency_msg;
+            handover_latency_msg.data = last_handover_latency_;
+            handover_latency_pub_->publish(handover_latency_msg);
+        }
+        RCLCPP_INFO(this->get_logger(), "Handover latency: %.1f ms", last_handover_latency_ * 1e3);
     }
-    rclcpp::sleep_for(1000ms);
     addBehaviorStamedArray("WallTracking Start");
     RCLCPP_INFO(this->get_logger(), "EXECUTE");
     const auto goal = goal_handle->get_goal();
     std::shared_ptr<WallTrackingAction::Feedback> feedback = std::make_shared<WallTrackingAction::Feedback>();
     auto result = std::make_shared<WallTrackingAction::Result>();
     wall_tracking_flg_ = true;
-    rclcpp::Rate loop_rate(20);
+    // フィードバック周期もノードのクロックで数える
+    const rclcpp::Duration feedback_period(50ms);
+    rclcpp::Time next_feedback = this->now();
     while (rclcpp::ok()) {
+        if (preempt_requested_ || goal_worker_stop_) {
+            // 次のゴールがすぐに壁沿いを引き継ぐので停止指令は出さない
+            result->get = false;
+            goal_handle->abort(result);
+            addBehaviorStamedArray("WallTracking Preempted");
+            RCLCPP_INFO(this->get_logger(), "Goal Preempted");
+            bool has_next_goal;
+            {
+                std::lock_guard<std::mutex> lock(goal_mutex_);
+                has_next_goal = static_cast<bool>(pending_goal_);
+            }
+            if(goal_worker_stop_ || !has_next_goal) wall_tracking_flg_ = false;
+            return;
+        }
         if (goal_handle->is_canceling()) {
             
             wall_tracking_flg_ = false;
@@ -387,15 +1277,30 @@ void WallTracking::execute(
             addBehaviorStamedArray("WallTracking Cancel");
             RCLCPP_INFO(this->get_logger(), "Goal Canceled");
             if(recieved_nav_goal_){
-                navigation_action_client_->async_send_goal(nav_goal_msgs_, nav_send_goal_options_);
+                nav2_msgs::action::NavigateToPose::Goal nav_goal;
+                {
+                    std::lock_guard<std::mutex> lock(behavior_mutex_);
+                    nav_goal = nav_goal_msgs_;
+                }
+                navigation_action_client_->async_send_goal(nav_goal, nav_send_goal_options_);
                 addBehaviorStamedArray("Navigation Resume");
                 RCLCPP_INFO(this->get_logger(), "Resume navigation");
             }
             return;
         }
-        feedback->open_place_arrived = open_place_;
+        feedback->open_place_arrived = latest_scan_features_.load().open_place;
         goal_handle->publish_feedback(feedback);
-        loop_rate.sleep();
+        next_feedback += feedback_period;
+        rclcpp::Time current = this->now();
+        if(next_feedback < current) next_feedback = current;
+        // シミュレーション時刻で/clockが止まるとsleep_untilは戻らないので、実時間の短い区切りで待つ。
+        // 中断はgoal_cv_で、キャンセルは区切りごとの確認ですぐに気づく
+        std::unique_lock<std::mutex> lock(goal_mutex_);
+        while(rclcpp::ok() && this->now() < next_feedback){
+            if(goal_cv_.wait_for(lock, 10ms, [this, &goal_handle]() {
+                return preempt_requested_.load() || goal_worker_stop_.load() || goal_handle->is_canceling();
+            })) break;
+        }
     }
     if (rclcpp::ok()) {
         result->get = true;
@@ -2,11 +2,80 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "wall_tracking_executor/wall_tracking_executor.hpp"
+#include "wall_tracking_executor/ExecutorFactory.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+// usage: wall_tracking_node [--executor <type>] [--threads <n>] [--ros-args ...]
+// The options override the executor_type / executor_threads parameters.
+namespace {
+const char *kUsage = "usage: wall_tracking_node [--executor <type>] [--threads <n>] [--ros-args ...]";
+
+// 符号や数字以外の文字を含む値、範囲外の値は受け付けない
+bool parseThreads(const std::string &arg, std::size_t &threads)
+{
+	if (arg.empty() || arg.find_first_not_of("0123456789") != std::string::npos) return false;
+	errno = 0;
+	unsigned long value = std::strtoul(arg.c_str(), nullptr, 10);
+	if (errno == ERANGE) return false;
+	threads = value;
+	return true;
+}
+} // namespace
 
 int main(int argc, char *argv[]) {
-	rclcpp::init(argc, argv);
+	std::vector<std::string> args = rclcpp::init_and_remove_ros_arguments(argc, argv);
+  	std::string executor_override;
+  	std::size_t threads_override = 0;
+  	bool has_threads = false;
+  	for (std::size_t i = 1; i < args.size(); ++i) {
+  		bool has_value = i + 1 < args.size();
+  		if (args[i] == "--executor" && has_value) executor_override = args[++i];
+  		else if (args[i] == "--threads" && has_value && parseThreads(args[i + 1], threads_override)) {
+  			has_threads = true;
+  			++i;
+  		} else if (args[i] == "--executor" || args[i] == "--threads") {
+  			std::cerr << "invalid value for " << args[i] << (has_value ? ": " + args[i + 1] : "") << std::endl;
+  			std::cerr << kUsage << std::endl;
+  			rclcpp::shutdown();
+  			return 1;
+  		}
+  	}
   	auto node = std::make_shared<WallTracking::WallTracking>();
-  	rclcpp::spin(node);
+  	std::string executor_type = executor_override.empty() ? node->executorType() : executor_override;
+  	std::size_t executor_threads = has_threads ? threads_override : node->executorThreads();
+  	rclcpp::Executor::SharedPtr executor;
+  	try {
+  		executor = WallTracking::createExecutor(executor_type, executor_threads);
+  	} catch (const std::invalid_argument &e) {
+  		RCLCPP_ERROR(node->get_logger(), "%s, falling back to single_threaded", e.what());
+  		executor_type = "single_threaded";
+  		executor = WallTracking::createExecutor(executor_type, executor_threads);
+  	}
+  	RCLCPP_INFO(node->get_logger(), "executor: %s (threads: %zu)", executor_type.c_str(), executor_threads);
+  	executor->add_node(node->get_node_base_interface());
+  	if (node->autostart()) {
+  		// ライフサイクル管理をしない場合は起動時にactiveまで遷移させる
+  		node->configure();
+  		node->activate();
+  	}
+
+  	rclcpp::executors::SingleThreadedExecutor realtime_executor;
+  	std::thread realtime_thread;
+  	if (node->realtimeMode()) {
+  		realtime_executor.add_callback_group(node->scanCallbackGroup(), node->get_node_base_interface());
+  		realtime_thread = std::thread([&]() {
+  			node->configureRealtimeThread();
+  			realtime_executor.spin();
+  		});
+  	}
+  	executor->spin();
+  	realtime_executor.cancel();
+  	if (realtime_thread.joinable()) realtime_thread.join();
   	rclcpp::shutdown();
   	return 0;
 }
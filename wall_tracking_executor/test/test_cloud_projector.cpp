@@ -0,0 +1,141 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "wall_tracking_executor/CloudProjector.hpp"
+
+using namespace WallTracking;
+
+namespace {
+struct Point
+{
+    float x, y, z;
+};
+
+// x, y, zの後ろに詰め物があるPointCloud2相当のバッファ
+struct Cloud
+{
+    static constexpr std::size_t kStep = 16;
+    std::vector<std::uint8_t> data;
+    std::size_t width = 0;
+
+    explicit Cloud(const std::vector<Point> &points)
+    : data(points.size() * kStep), width(points.size())
+    {
+        for (std::size_t i = 0; i < points.size(); ++i) std::memcpy(&data[i * kStep], &points[i], sizeof(Point));
+    }
+
+    CloudLayout layout() const
+    {
+        CloudLayout l;
+        l.data = data.data();
+        l.width = width;
+        l.height = 1;
+        l.point_step = kStep;
+        l.row_step = width * kStep;
+        l.x_offset = 0;
+        l.y_offset = 4;
+        l.z_offset = 8;
+        return l;
+    }
+};
+
+CloudProjector configured()
+{
+    CloudProjector projector;
+    std::string err;
+    EXPECT_TRUE(projector.configure(CloudSliceConfig(), err)) << err;
+    return projector;
+}
+
+// 既定の設定(-180度から0.25度刻み)でのビン番号
+std::size_t binOf(float deg)
+{
+    return static_cast<std::size_t>((deg + 180.f) / 0.25f);
+}
+} // namespace
+
+TEST(CloudProjector, RejectsInvalidSlice)
+{
+    CloudProjector projector;
+    std::string err;
+    CloudSliceConfig config;
+    config.min_height = 1.;
+    config.max_height = 0.;
+    EXPECT_FALSE(projector.configure(config, err));
+    EXPECT_FALSE(err.empty());
+    config = CloudSliceConfig();
+    config.angle_increment_deg = 0.;
+    EXPECT_FALSE(projector.configure(config, err));
+    config = CloudSliceConfig();
+    config.range_min = 40.;
+    EXPECT_FALSE(projector.configure(config, err));
+}
+
+TEST(CloudProjector, NearestPointInSliceWins)
+{
+    CloudProjector projector = configured();
+    EXPECT_EQ(projector.size(), 1440u);
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    Cloud cloud({
+        {2.f, 0.f, 0.f},
+        {1.f, 0.f, 0.2f},   //同じビンのより近い点
+        {0.5f, 0.f, 1.f},   //スライスより上
+        {0.f, 3.f, 0.f},    //左
+        {0.f, 0.05f, 0.f},  //range_minより近い
+        {nan, 1.f, 0.f},
+        {-4.f, -0.001f, 0.f}, //-180度側のビン
+    });
+    ASSERT_TRUE(projector.project(cloud.layout()));
+    EXPECT_EQ(projector.pointsInSlice(), 4u);
+    RangeView ranges = projector.ranges();
+    EXPECT_FLOAT_EQ(ranges[binOf(0.f)], 1.f);
+    EXPECT_FLOAT_EQ(ranges[binOf(90.f)], 3.f);
+    EXPECT_NEAR(ranges[0], 4.f, 1e-5);
+    std::size_t finite = 0;
+    for (float r : ranges) finite += std::isfinite(r);
+    EXPECT_EQ(finite, 3u);
+}
+
+TEST(CloudProjector, ResetsBinsBetweenClouds)
+{
+    CloudProjector projector = configured();
+    Cloud first({{1.f, 1.f, 0.f}});
+    ASSERT_TRUE(projector.project(first.layout()));
+    EXPECT_FLOAT_EQ(projector.ranges()[binOf(45.f)], std::sqrt(2.f));
+    Cloud second({{0.f, -2.f, 0.f}});
+    ASSERT_TRUE(projector.project(second.layout()));
+    EXPECT_TRUE(std::isinf(projector.ranges()[binOf(45.f)]));
+    EXPECT_FLOAT_EQ(projector.ranges()[binOf(-90.f)], 2.f);
+}
+
+TEST(CloudProjector, SpansSeveralChunks)
+{
+    // チャンクの境目をまたいでも全ての点を数える
+    std::vector<Point> points;
+    for (int i = 0; i < 1000; ++i) points.push_back({1.f + 0.001f * static_cast<float>(i), 0.f, 0.f});
+    Cloud cloud(points);
+    CloudProjector projector = configured();
+    ASSERT_TRUE(projector.project(cloud.layout()));
+    EXPECT_EQ(projector.pointsInSlice(), 1000u);
+    EXPECT_FLOAT_EQ(projector.ranges()[binOf(0.f)], 1.f);
+}
+
+TEST(CloudProjector, RejectsLayoutOutsideBuffer)
+{
+    CloudProjector projector = configured();
+    Cloud cloud({{1.f, 0.f, 0.f}});
+    CloudLayout layout = cloud.layout();
+    layout.z_offset = 14; //floatが点の外にはみ出す
+    EXPECT_FALSE(projector.project(layout));
+    layout = cloud.layout();
+    layout.row_step = 8;
+    EXPECT_FALSE(projector.project(layout));
+}
@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "wall_tracking_executor/DecisionTrace.hpp"
+
+using namespace WallTracking;
+
+namespace {
+std::string tracePath(const std::string &name)
+{
+    std::string path = testing::TempDir() + "wt_" + name + "_" + std::to_string(getpid()) + ".trace";
+    std::remove(path.c_str());
+    std::remove((path + ".prev").c_str());
+    return path;
+}
+
+void writeRecords(const std::string &path, std::int64_t first_stamp, int n)
+{
+    DecisionTraceWriter writer;
+    std::string err;
+    ASSERT_TRUE(writer.open(path, 16, err)) << err;
+    Decision decision;
+    for (int i = 0; i < n; ++i) {
+        decision.linear_x = 0.1f * static_cast<float>(first_stamp + i);
+        writer.push(toTraceRecord(first_stamp + i, decision));
+    }
+    writer.close();
+    EXPECT_EQ(writer.written(), static_cast<std::uint64_t>(n));
+    EXPECT_EQ(writer.dropped(), 0u);
+}
+
+off_t fileSize(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+} // namespace
+
+TEST(DecisionTrace, RoundTrip)
+{
+    std::string path = tracePath("roundtrip");
+    writeRecords(path, 100, 5);
+    std::vector<TraceRecord> records;
+    std::string err;
+    ASSERT_TRUE(readDecisionTrace(path, records, err)) << err;
+    ASSERT_EQ(records.size(), 5u);
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        EXPECT_EQ(records[i].seq, i);
+        EXPECT_EQ(records[i].stamp_ns, static_cast<std::int64_t>(100 + i));
+        EXPECT_FLOAT_EQ(records[i].linear_x, 0.1f * static_cast<float>(100 + i));
+    }
+    std::remove(path.c_str());
+}
+
+TEST(DecisionTrace, AppendAfterTornRecord)
+{
+    std::string path = tracePath("torn");
+    writeRecords(path, 0, 3);
+    // 3件目の途中で落ちた状態を作る
+    ASSERT_EQ(truncate(path.c_str(), fileSize(path) - static_cast<off_t>(sizeof(TraceRecord) / 2)), 0);
+    writeRecords(path, 10, 3);
+
+    std::vector<TraceRecord> records;
+    std::string err;
+    ASSERT_TRUE(readDecisionTrace(path, records, err)) << err;
+    ASSERT_EQ(records.size(), 5u);
+    const std::int64_t stamps[] = {0, 1, 10, 11, 12};
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        EXPECT_EQ(records[i].stamp_ns, stamps[i]);
+        // 再オープン後もseqは続きから増える
+        EXPECT_EQ(records[i].seq, i);
+    }
+    std::remove(path.c_str());
+}
+
+TEST(DecisionTrace, ForeignFileIsMovedAside)
+{
+    std::string path = tracePath("foreign");
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    const char junk[] = "not a decision trace at all, keep me";
+    std::fwrite(junk, sizeof(junk), 1, file);
+    std::fclose(file);
+
+    DecisionTraceWriter writer;
+    std::string err;
+    ASSERT_TRUE(writer.open(path, 16, err)) << err;
+    EXPECT_EQ(writer.movedAside(), path + ".prev");
+    writer.push(toTraceRecord(7, Decision()));
+    writer.close();
+
+    EXPECT_EQ(fileSize(path + ".prev"), static_cast<off_t>(sizeof(junk)));
+    std::vector<TraceRecord> records;
+    ASSERT_TRUE(readDecisionTrace(path, records, err)) << err;
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].stamp_ns, 7);
+    std::remove(path.c_str());
+    std::remove((path + ".prev").c_str());
+}
@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "wall_tracking_executor/DurationHistogram.hpp"
+
+using namespace WallTracking;
+
+TEST(DurationHistogram, EmptyWindow)
+{
+    DurationHistogram histogram;
+    DurationSummary s = histogram.takeSummary();
+    EXPECT_EQ(s.count, 0u);
+    EXPECT_EQ(s.p50, 0.f);
+    EXPECT_EQ(s.max, 0.f);
+}
+
+TEST(DurationHistogram, PercentilesAreBucketUpperEdges)
+{
+    DurationHistogram histogram;
+    // 1msが90回、10msが9回、50msが1回
+    for (int i = 0; i < 90; ++i) histogram.record(0.001f);
+    for (int i = 0; i < 9; ++i) histogram.record(0.01f);
+    histogram.record(0.05f);
+    DurationSummary s = histogram.takeSummary();
+    EXPECT_EQ(s.count, 100u);
+    EXPECT_FLOAT_EQ(s.max, 0.05f);
+    // バケットの上端を返すので真の値以上、19%以内
+    EXPECT_GE(s.p50, 0.001f);
+    EXPECT_LE(s.p50, 0.001f * 1.19f);
+    EXPECT_GE(s.p90, 0.001f);
+    EXPECT_LE(s.p90, 0.001f * 1.19f);
+    EXPECT_GE(s.p99, 0.01f);
+    EXPECT_LE(s.p99, 0.01f * 1.19f);
+}
+
+TEST(DurationHistogram, PercentileNeverExceedsMax)
+{
+    DurationHistogram histogram;
+    histogram.record(0.0011f);
+    DurationSummary s = histogram.takeSummary();
+    EXPECT_FLOAT_EQ(s.p99, 0.0011f);
+}
+
+TEST(DurationHistogram, ClampsOutOfRangeDurations)
+{
+    DurationHistogram histogram;
+    histogram.record(0.f);
+    histogram.record(1e-9f);
+    histogram.record(1e6f);
+    DurationSummary s = histogram.takeSummary();
+    EXPECT_EQ(s.count, 3u);
+    EXPECT_FLOAT_EQ(s.p50, DurationHistogram::bucketUpperEdge(0));
+    EXPECT_FLOAT_EQ(s.p99, DurationHistogram::bucketUpperEdge(DurationHistogram::kBuckets - 1));
+}
+
+TEST(DurationHistogram, SummaryStartsNextWindow)
+{
+    DurationHistogram histogram;
+    histogram.record(0.01f);
+    EXPECT_EQ(histogram.takeSummary().count, 1u);
+    EXPECT_EQ(histogram.takeSummary().count, 0u);
+    histogram.record(0.002f);
+    DurationSummary s = histogram.takeSummary();
+    EXPECT_EQ(s.count, 1u);
+    EXPECT_FLOAT_EQ(s.max, 0.002f);
+}
+
+TEST(DurationHistogram, ConcurrentSummariesLoseNoSamples)
+{
+    // 記録するスレッドと集計するスレッドが別でも件数は失われない
+    DurationHistogram histogram;
+    constexpr int kSamples = 200000;
+    std::thread writer([&histogram]() {
+        for (int i = 0; i < kSamples; ++i) histogram.record(0.0001f * static_cast<float>(i % 100 + 1));
+    });
+    std::uint64_t total = 0;
+    for (int i = 0; i < 100; ++i) total += histogram.takeSummary().count;
+    writer.join();
+    total += histogram.takeSummary().count;
+    EXPECT_EQ(total, static_cast<std::uint64_t>(kSamples));
+}
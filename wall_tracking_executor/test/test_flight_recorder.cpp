@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "wall_tracking_executor/FlightRecorder.hpp"
+
+using namespace WallTracking;
+
+namespace {
+std::string recorderPath(const std::string &name)
+{
+    std::string path = testing::TempDir() + "wt_" + name + "_" + std::to_string(getpid()) + ".rec";
+    std::remove(path.c_str());
+    std::remove((path + ".prev").c_str());
+    return path;
+}
+
+void recordScans(FlightRecorder &recorder, std::int64_t first_stamp, int n)
+{
+    std::vector<float> ranges{1.f, 2.f, 3.f, 4.f};
+    for (int i = 0; i < n; ++i) {
+        FlightRecord r;
+        r.stamp_ns = first_stamp + i;
+        ranges[0] = static_cast<float>(first_stamp + i);
+        recorder.record(r, RangeView(ranges));
+    }
+}
+} // namespace
+
+TEST(FlightRecorder, RoundTripKeepsNewestSlots)
+{
+    std::string path = recorderPath("ring");
+    FlightRecorder recorder;
+    std::string err;
+    ASSERT_TRUE(recorder.open(path, 4, 4, err)) << err;
+    recordScans(recorder, 0, 6);
+    recorder.close();
+
+    std::vector<FlightRecord> records;
+    std::vector<float> ranges;
+    std::size_t max_ranges = 0;
+    ASSERT_TRUE(readFlightRecords(path, records, &ranges, max_ranges, err)) << err;
+    ASSERT_EQ(records.size(), 4u);
+    ASSERT_EQ(max_ranges, 4u);
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        EXPECT_EQ(records[i].stamp_ns, static_cast<std::int64_t>(2 + i));
+        EXPECT_EQ(records[i].seq, 3 + i);
+        EXPECT_EQ(records[i].range_count, 4u);
+        EXPECT_FLOAT_EQ(ranges[i * max_ranges], static_cast<float>(2 + i));
+    }
+    std::remove(path.c_str());
+}
+
+TEST(FlightRecorder, ReopenContinuesSequence)
+{
+    std::string path = recorderPath("reopen");
+    FlightRecorder recorder;
+    std::string err;
+    ASSERT_TRUE(recorder.open(path, 8, 0, err)) << err;
+    recordScans(recorder, 0, 3);
+    recorder.close();
+    ASSERT_TRUE(recorder.open(path, 8, 0, err)) << err;
+    EXPECT_TRUE(recorder.movedAside().empty());
+    recordScans(recorder, 10, 2);
+    recorder.close();
+
+    std::vector<FlightRecord> records;
+    std::size_t max_ranges = 0;
+    ASSERT_TRUE(readFlightRecords(path, records, nullptr, max_ranges, err)) << err;
+    ASSERT_EQ(records.size(), 5u);
+    EXPECT_EQ(records[3].stamp_ns, 10);
+    EXPECT_EQ(records[4].seq, 5u);
+    std::remove(path.c_str());
+}
+
+TEST(FlightRecorder, LayoutChangeKeepsPreviousMission)
+{
+    std::string path = recorderPath("layout");
+    FlightRecorder recorder;
+    std::string err;
+    ASSERT_TRUE(recorder.open(path, 8, 0, err)) << err;
+    recordScans(recorder, 0, 3);
+    recorder.close();
+    // スロット数を変えて開き直しても前回の記録は消えない
+    ASSERT_TRUE(recorder.open(path, 16, 4, err)) << err;
+    EXPECT_EQ(recorder.movedAside(), path + ".prev");
+    recordScans(recorder, 100, 1);
+    recorder.close();
+
+    std::vector<FlightRecord> records;
+    std::size_t max_ranges = 0;
+    ASSERT_TRUE(readFlightRecords(path + ".prev", records, nullptr, max_ranges, err)) << err;
+    EXPECT_EQ(records.size(), 3u);
+    ASSERT_TRUE(readFlightRecords(path, records, nullptr, max_ranges, err)) << err;
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].stamp_ns, 100);
+    std::remove(path.c_str());
+    std::remove((path + ".prev").c_str());
+}
@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include "wall_tracking_executor/LoadGovernor.hpp"
+
+using namespace WallTracking;
+
+namespace {
+GovernorConfig tenMillisecondBudget()
+{
+    GovernorConfig config;
+    config.budget = 0.01;
+    config.degrade_scans = 5;
+    config.recover_scans = 20;
+    return config;
+}
+
+// levelが変わるまでdurationを与え続け、かかったスキャン数を返す(変わらなければ-1)
+int scansUntilChange(LoadGovernor &governor, float duration, int limit = 1000)
+{
+    for (int i = 1; i <= limit; ++i) {
+        if (governor.update(duration)) return i;
+    }
+    return -1;
+}
+} // namespace
+
+TEST(LoadGovernor, DisabledWithoutBudget)
+{
+    LoadGovernor governor;
+    EXPECT_EQ(scansUntilChange(governor, 1.f), -1);
+    EXPECT_EQ(governor.level(), LoadLevel::FULL);
+    EXPECT_TRUE(governor.debugOutputs());
+    EXPECT_TRUE(governor.deskew());
+    EXPECT_TRUE(governor.allSectors());
+}
+
+TEST(LoadGovernor, ShedsOneLevelAtATime)
+{
+    LoadGovernor governor;
+    governor.configure(tenMillisecondBudget());
+    EXPECT_EQ(scansUntilChange(governor, 0.02f), 5);
+    EXPECT_EQ(governor.level(), LoadLevel::NO_DEBUG);
+    EXPECT_FALSE(governor.debugOutputs());
+    EXPECT_TRUE(governor.deskew());
+    // 段階を変えたら数え直す
+    EXPECT_EQ(scansUntilChange(governor, 0.02f), 5);
+    EXPECT_EQ(governor.level(), LoadLevel::NO_DESKEW);
+    EXPECT_FALSE(governor.deskew());
+    EXPECT_EQ(scansUntilChange(governor, 0.02f), 5);
+    EXPECT_EQ(governor.level(), LoadLevel::REDUCED_SECTORS);
+    EXPECT_FALSE(governor.allSectors());
+    EXPECT_EQ(scansUntilChange(governor, 0.02f, 100), -1);
+}
+
+TEST(LoadGovernor, HoldsLevelBetweenThresholds)
+{
+    LoadGovernor governor;
+    governor.configure(tenMillisecondBudget());
+    // 予算の60%から100%の間では上げも下げもしない
+    EXPECT_EQ(scansUntilChange(governor, 0.008f, 500), -1);
+    EXPECT_EQ(governor.level(), LoadLevel::FULL);
+    ASSERT_EQ(scansUntilChange(governor, 0.05f), 5);
+    // 平均が予算を下回るまでの数スキャンは過負荷が続いていると見なす
+    for (int i = 0; i < 10; ++i) governor.update(0.008f);
+    LoadLevel level = governor.level();
+    EXPECT_EQ(scansUntilChange(governor, 0.008f, 500), -1);
+    EXPECT_EQ(governor.level(), level);
+}
+
+TEST(LoadGovernor, RecoversAfterQuietScans)
+{
+    LoadGovernor governor;
+    governor.configure(tenMillisecondBudget());
+    ASSERT_EQ(scansUntilChange(governor, 0.02f), 5);
+    // 平均が下がりきるまでのスキャンも含めて recover_scans 以上かかる
+    int scans = scansUntilChange(governor, 0.001f);
+    EXPECT_GE(scans, 20);
+    EXPECT_LT(scans, 40);
+    EXPECT_EQ(governor.level(), LoadLevel::FULL);
+    EXPECT_EQ(scansUntilChange(governor, 0.001f, 200), -1);
+}
+
+TEST(LoadGovernor, SmoothsSingleSpikes)
+{
+    LoadGovernor governor;
+    governor.configure(tenMillisecondBudget());
+    for (int i = 0; i < 200; ++i) {
+        // 10回に1回だけ予算の3倍かかっても平均は予算内
+        EXPECT_FALSE(governor.update(i % 10 == 9 ? 0.03f : 0.005f));
+    }
+    EXPECT_EQ(governor.level(), LoadLevel::FULL);
+}
+
+TEST(LoadGovernor, ConfigureResetsLevel)
+{
+    LoadGovernor governor;
+    governor.configure(tenMillisecondBudget());
+    ASSERT_EQ(scansUntilChange(governor, 0.02f), 5);
+    governor.configure(tenMillisecondBudget());
+    EXPECT_EQ(governor.level(), LoadLevel::FULL);
+    EXPECT_EQ(governor.meanDuration(), 0.f);
+    EXPECT_STREQ(toString(LoadLevel::NO_DESKEW), "no debug output, no deskew");
+}
@@ -0,0 +1,163 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "wall_tracking_executor/ScanData.hpp"
+
+using namespace WallTracking;
+
+namespace {
+constexpr int kBeams = 1440;
+constexpr float kInf = std::numeric_limits<float>::infinity();
+
+// 10HzのLiDARとして時刻ずれを持たせる
+ScanGeometry rotatingLidar()
+{
+    ScanGeometry g;
+    g.angle_increment = static_cast<float>(2. * M_PI / kBeams);
+    g.angle_min = static_cast<float>(-M_PI);
+    g.angle_max = g.angle_min + g.angle_increment * (kBeams - 1);
+    g.time_increment = 0.1f / kBeams;
+    g.range_min = 0.1;
+    g.range_max = 30.;
+    return g;
+}
+
+// 半径radiusの円筒の中心から見たスキャン
+std::vector<float> circle(float radius)
+{
+    return std::vector<float>(kBeams, radius);
+}
+} // namespace
+
+TEST(ScanData, ReadsCallerBufferWithoutCopy)
+{
+    std::vector<float> ranges = circle(2.f);
+    ScanData scan(kBeams);
+    scan.dataUpdate(RangeView(ranges), rotatingLidar());
+    EXPECT_EQ(scan.size(), static_cast<std::size_t>(kBeams));
+    EXPECT_EQ(scan.ranges().data(), ranges.data());
+    EXPECT_EQ(scan.deg2index(0.f), kBeams / 2);
+    EXPECT_NEAR(scan.index2deg(scan.deg2index(90.f)), 90.f, 0.25f);
+}
+
+TEST(ScanData, DeskewWithoutMotionKeepsRanges)
+{
+    std::vector<float> ranges = circle(2.f);
+    for (int i = 0; i < kBeams; ++i) ranges[i] += 0.5f * std::sin(0.01f * static_cast<float>(i));
+    ScanData scan(kBeams);
+    scan.dataUpdate(RangeView(ranges), rotatingLidar());
+    scan.deskew(0.f, 0.f);
+    RangeView out = scan.ranges();
+    ASSERT_EQ(out.size(), ranges.size());
+    EXPECT_NE(out.data(), ranges.data());
+    for (int i = 0; i < kBeams; ++i) EXPECT_NEAR(out[i], ranges[i], 1e-4) << "beam " << i;
+}
+
+TEST(ScanData, DeskewRotatesEarlierBeams)
+{
+    // その場で反時計回りに旋回していれば円筒までの距離は変わらない。
+    // ビームの間隔が広がって空いたビンは両隣で埋まり、-180度のビームは+180度側へ折り返す
+    std::vector<float> ranges = circle(2.f);
+    ScanData scan(kBeams);
+    scan.dataUpdate(RangeView(ranges), rotatingLidar());
+    scan.deskew(0.f, 0.7f);
+    RangeView out = scan.ranges();
+    for (int i = 0; i < kBeams; ++i) EXPECT_NEAR(out[i], 2.f, 1e-4) << "beam " << i;
+}
+
+TEST(ScanData, DeskewTwiceKeepsFirstResult)
+{
+    std::vector<float> ranges = circle(2.f);
+    ScanData scan(kBeams);
+    scan.dataUpdate(RangeView(ranges), rotatingLidar());
+    scan.deskew(0.f, 0.7f);
+    std::vector<float> first(scan.ranges().begin(), scan.ranges().end());
+    scan.deskew(0.2f, -0.7f);
+    RangeView out = scan.ranges();
+    for (int i = 0; i < kBeams; ++i) EXPECT_EQ(out[i], first[i]) << "beam " << i;
+    // 新しいスキャンを渡せばまた補正する
+    scan.dataUpdate(RangeView(ranges), rotatingLidar());
+    scan.deskew(0.f, 0.7f);
+    EXPECT_NE(scan.ranges().data(), ranges.data());
+}
+
+TEST(ScanData, DeskewLeavesUncoveredBinsEmpty)
+{
+    // 前方180度だけのスキャン。時計回りに旋回すると、先に測った右端のビームは範囲の内側へずれる
+    ScanGeometry g = rotatingLidar();
+    const int beams = kBeams / 2;
+    g.angle_min = static_cast<float>(-M_PI / 2);
+    g.angle_max = g.angle_min + g.angle_increment * (beams - 1);
+    std::vector<float> ranges(beams, 2.f);
+    ScanData scan(beams);
+    scan.dataUpdate(RangeView(ranges), g);
+    const float w = -0.7f;
+    scan.deskew(0.f, w);
+    RangeView out = scan.ranges();
+    // どのビームも落ちなかったビンには生の値を残さない
+    int uncovered = static_cast<int>(-w * g.time_increment * (beams - 1) / g.angle_increment);
+    for (int i = 0; i < uncovered - 1; ++i) EXPECT_TRUE(std::isinf(out[i])) << "beam " << i << ": " << out[i];
+    for (int i = uncovered + 1; i < beams; ++i) EXPECT_NEAR(out[i], 2.f, 1e-4) << "beam " << i;
+}
+
+TEST(ScanData, DeskewKeepsInvalidBeamsInvalid)
+{
+    std::vector<float> ranges = circle(2.f);
+    ranges[100] = kInf;
+    ranges[101] = 0.f; //range_min未満
+    ScanData scan(kBeams);
+    scan.dataUpdate(RangeView(ranges), rotatingLidar());
+    scan.deskew(0.1f, 0.f);
+    RangeView out = scan.ranges();
+    EXPECT_TRUE(std::isinf(out[100]));
+    EXPECT_TRUE(std::isinf(out[101]));
+    EXPECT_TRUE(std::isfinite(out[99]));
+    EXPECT_TRUE(std::isfinite(out[102]));
+}
+
+TEST(ScanData, DeskewTableFollowsAngularVelocity)
+{
+    // 同じ角速度では表を使い回し、変われば作り直す
+    std::vector<float> ranges = circle(2.f);
+    for (int i = 0; i < kBeams; ++i) ranges[i] += 0.5f * std::sin(0.01f * static_cast<float>(i));
+    ScanData scan(kBeams);
+    auto deskewed = [&](float w) {
+        scan.dataUpdate(RangeView(ranges), rotatingLidar());
+        scan.deskew(0.2f, w);
+        RangeView out = scan.ranges();
+        return std::vector<float>(out.begin(), out.end());
+    };
+    std::vector<float> first = deskewed(0.5f);
+    std::vector<float> other = deskewed(-0.5f);
+    EXPECT_EQ(deskewed(0.5f), first);
+    EXPECT_NE(other, first);
+    EXPECT_EQ(deskewed(-0.5f), other);
+}
+
+TEST(ScanData, WallChecks)
+{
+    // 前方0.5mに壁、左は0.8mに壁
+    std::vector<float> ranges(kBeams);
+    ScanGeometry g = rotatingLidar();
+    for (int i = 0; i < kBeams; ++i) {
+        float a = g.angle_min + g.angle_increment * static_cast<float>(i);
+        float c = std::cos(a), s = std::sin(a);
+        float front = c > 0.f ? 0.5f / c : kInf, left = s > 0.f ? 0.8f / s : kInf;
+        ranges[i] = std::min(front, left);
+    }
+    ScanData scan(kBeams);
+    scan.dataUpdate(RangeView(ranges), g);
+    EXPECT_FLOAT_EQ(scan.frontWallCheck(-10.f, 0.8f), 1.f);
+    EXPECT_NEAR(scan.leftWallCheck(69.f, 78.f), 0.8f, 1e-3);
+    EXPECT_FALSE(scan.conflictCheck(90.f, 0.9f));
+    float per, mean;
+    // 後方は何もないので開けている
+    scan.openPlaceCheck(-180.f, -100.f, 12.5f, per, mean);
+    EXPECT_FLOAT_EQ(per, 1.f);
+}
@@ -0,0 +1,117 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "wall_tracking_executor/ScanFuser.hpp"
+
+using namespace WallTracking;
+
+namespace {
+constexpr int kBeams = 360;
+constexpr std::int64_t kSkew = 50000000; //50ms
+
+// 1度刻みで一周するセンサ
+ScanGeometry sensorGeometry()
+{
+    ScanGeometry g;
+    g.angle_increment = static_cast<float>(DEG2RAD(1.));
+    g.angle_min = static_cast<float>(-M_PI);
+    g.angle_max = g.angle_min + g.angle_increment * (kBeams - 1);
+    g.range_min = 0.05;
+    g.range_max = 20.;
+    return g;
+}
+
+// センサ座標系でangle_deg方向だけに距離rangeの点があるスキャン
+std::vector<float> singleReturn(float angle_deg, float range)
+{
+    std::vector<float> ranges(kBeams, std::numeric_limits<float>::infinity());
+    ranges[static_cast<int>(std::lround(angle_deg + 180.f))] = range;
+    return ranges;
+}
+
+// 仮想スキャン(既定: -180度から0.25度刻み)でのビン番号
+std::size_t binOf(float deg)
+{
+    return static_cast<std::size_t>(std::lround((deg + 180.f) / 0.25f));
+}
+
+class ScanFuserTest : public testing::Test
+{
+protected:
+    ScanFuser fuser_;
+
+    void SetUp() override
+    {
+        // 前方0.3mで正面向きのセンサと、左0.2mで左向きのセンサ
+        std::vector<SensorPose> poses(2);
+        poses[0].x = 0.3;
+        poses[1].y = 0.2;
+        poses[1].yaw_deg = 90.;
+        std::string err;
+        ASSERT_TRUE(fuser_.configure(VirtualScanConfig(), poses, kBeams, err)) << err;
+    }
+
+    // 距離が最小のビンを返す
+    std::size_t nearestBin() const
+    {
+        RangeView r = fuser_.ranges();
+        return static_cast<std::size_t>(std::min_element(r.begin(), r.end()) - r.begin());
+    }
+};
+} // namespace
+
+TEST_F(ScanFuserTest, RejectsBadConfiguration)
+{
+    ScanFuser fuser;
+    std::string err;
+    EXPECT_FALSE(fuser.configure(VirtualScanConfig(), {}, kBeams, err));
+    VirtualScanConfig config;
+    config.angle_increment_deg = -1.;
+    EXPECT_FALSE(fuser.configure(config, {SensorPose()}, kBeams, err));
+    EXPECT_FALSE(fuser_.update(2, 0, RangeView(singleReturn(0.f, 1.f)), sensorGeometry()));
+    std::vector<float> too_many(kBeams + 1, 1.f);
+    EXPECT_FALSE(fuser_.update(0, 0, RangeView(too_many), sensorGeometry()));
+}
+
+TEST_F(ScanFuserTest, MovesEachSensorIntoBaseFrame)
+{
+    // 前のセンサの正面1.7m先 -> ベースの正面2m
+    ASSERT_TRUE(fuser_.update(0, 1000, RangeView(singleReturn(0.f, 1.7f)), sensorGeometry()));
+    EXPECT_EQ(fuser_.fuse(1000, kSkew, 0.f, 0.f), 1u);
+    EXPECT_EQ(nearestBin(), binOf(0.f));
+    EXPECT_NEAR(fuser_.ranges()[binOf(0.f)], 2.f, 1e-4);
+
+    // 左のセンサの正面0.8m先 -> ベースの左1m
+    ASSERT_TRUE(fuser_.update(1, 1000, RangeView(singleReturn(0.f, 0.8f)), sensorGeometry()));
+    EXPECT_EQ(fuser_.fuse(1000, kSkew, 0.f, 0.f), 2u);
+    EXPECT_EQ(nearestBin(), binOf(90.f));
+    EXPECT_NEAR(fuser_.ranges()[binOf(90.f)], 1.f, 1e-4);
+    EXPECT_NEAR(fuser_.ranges()[binOf(0.f)], 2.f, 1e-4);
+}
+
+TEST_F(ScanFuserTest, SkipsSensorsOutsideSkew)
+{
+    ASSERT_TRUE(fuser_.update(0, 0, RangeView(singleReturn(0.f, 1.7f)), sensorGeometry()));
+    ASSERT_TRUE(fuser_.update(1, 2 * kSkew, RangeView(singleReturn(0.f, 0.8f)), sensorGeometry()));
+    EXPECT_EQ(fuser_.newestStamp(), 2 * kSkew);
+    EXPECT_EQ(fuser_.fuse(fuser_.newestStamp(), kSkew, 0.f, 0.f), 1u);
+    EXPECT_EQ(fuser_.sensorsFused(), 1u);
+    EXPECT_TRUE(std::isinf(fuser_.ranges()[binOf(0.f)]));
+    EXPECT_NEAR(fuser_.ranges()[binOf(90.f)], 1.f, 1e-4);
+}
+
+TEST_F(ScanFuserTest, MovesOlderScanForwardWithTwist)
+{
+    // 20ms前のスキャンを0.5m/sで前進した分だけ近づける
+    ASSERT_TRUE(fuser_.update(0, 0, RangeView(singleReturn(0.f, 1.7f)), sensorGeometry()));
+    EXPECT_EQ(fuser_.fuse(20000000, kSkew, 0.5f, 0.f), 1u);
+    EXPECT_NEAR(fuser_.ranges()[binOf(0.f)], 2.f - 0.5f * 0.02f, 1e-4);
+}
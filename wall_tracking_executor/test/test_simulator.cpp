@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "wall_tracking_executor/Simulator.hpp"
+
+using namespace WallTracking;
+
+namespace {
+// config/wall_tracking_executor.param.yamlと同じ値
+ControlParams defaultParams()
+{
+    ControlParams p;
+    p.distance_from_wall = 0.8;
+    p.distance_to_stop = 0.8;
+    p.max_linear_vel = 0.22;
+    p.max_angular_vel = 0.7;
+    p.min_angular_vel = -0.7;
+    p.sampling_rate = 0.033;
+    p.kp = 12.;
+    p.start_deg_lateral = 69;
+    p.end_deg_lateral = 78;
+    p.stop_ray_th = 0.1;
+    p.wheel_separation = 0.28;
+    p.distance_to_skip = 0.6;
+    p.open_place_distance = 12.5;
+    const float div[] = {-9., 9., 9., 27., -27., -9., 27., 45., -45., -27.};
+    const float angvel[] = {0., 0.2, -0.2, 0.35, -0.35};
+    p.sector_num = 5;
+    std::copy(std::begin(div), std::end(div), p.detection_div_deg);
+    std::copy(std::begin(angvel), std::end(angvel), p.select_angvel);
+    std::string err;
+    EXPECT_TRUE(computeDerived(p, err)) << err;
+    return p;
+}
+
+EpisodeConfig corridorEpisode(const World &world, const Pose2D &start)
+{
+    EpisodeConfig config;
+    config.world = &world;
+    config.params = defaultParams();
+    config.start = start;
+    config.duration = 60.;
+    config.mission_distance = 10.;
+    config.seed = 1;
+    return config;
+}
+} // namespace
+
+TEST(World, DistanceToWall)
+{
+    World world = World::corridor(30., 3.);
+    EXPECT_EQ(world.segmentCount(), 5u);
+    EXPECT_NEAR(world.distanceToWall(10., 1.), 1., 1e-5);
+    EXPECT_NEAR(world.distanceToWall(10., 2.2), 0.8, 1e-5);
+    // 左の壁のドアの前ではドアの端が最寄りになる
+    EXPECT_NEAR(world.distanceToWall(15.5, 2.2), std::hypot(0.5, 0.8), 1e-5);
+}
+
+TEST(World, MakeWorldPutsWallOnTheLeft)
+{
+    World world;
+    Pose2D start;
+    std::string err;
+    ASSERT_TRUE(makeWorld("loop", 0.8, world, start, err)) << err;
+    EXPECT_NEAR(world.distanceToWall(start.x, start.y), 0.8, 1e-5);
+    // 左手(yaw + 90度)に0.8 mで壁がある
+    float lx = start.x + 0.8f * std::cos(start.yaw + static_cast<float>(M_PI_2));
+    float ly = start.y + 0.8f * std::sin(start.yaw + static_cast<float>(M_PI_2));
+    EXPECT_NEAR(world.distanceToWall(lx, ly), 0., 1e-4);
+    EXPECT_FALSE(makeWorld("/nonexistent/world.txt", 0.8, world, start, err));
+}
+
+TEST(LidarSimulator, RangesMatchTheWalls)
+{
+    World world = World::corridor(30., 3.);
+    LidarModel model;
+    model.beams = 360;
+    model.noise_stddev = 0.;
+    LidarSimulator lidar(model);
+    std::mt19937 rng(0);
+    RangeView ranges = lidar.scan(world, 10., 1., 0., rng);
+    ASSERT_EQ(ranges.size(), 360u);
+    const ScanGeometry &g = lidar.geometry();
+    auto beamAt = [&](float deg) {
+        return static_cast<std::size_t>(std::lround((deg * M_PI / 180. - g.angle_min) / g.angle_increment));
+    };
+    EXPECT_NEAR(ranges[beamAt(90.)], 2., 1e-3);
+    EXPECT_NEAR(ranges[beamAt(-90.)], 1., 1e-3);
+    // range_maxより遠い前方の壁は計測なし
+    EXPECT_TRUE(std::isinf(ranges[beamAt(0.)]));
+}
+
+TEST(Simulator, TracksTheCorridorWall)
+{
+    World world;
+    Pose2D start;
+    std::string err;
+    ASSERT_TRUE(makeWorld("corridor", 0.8, world, start, err)) << err;
+    EpisodeConfig config = corridorEpisode(world, start);
+    EpisodeResult result = runEpisode(config);
+    // 壁から離れず、ぶつからずに決められた距離を走り切る
+    EXPECT_FALSE(result.collided);
+    EXPECT_TRUE(result.completed);
+    EXPECT_GE(result.distance, config.mission_distance);
+    EXPECT_LT(result.rms_wall_error, 0.05);
+    EXPECT_LT(result.max_wall_error, 0.2);
+    EXPECT_EQ(result.turns, 0u);
+    EXPECT_NEAR(result.final_pose.y, 3. - config.params.distance_from_wall, 0.1);
+}
+
+TEST(Simulator, EpisodesAreReproducibleAcrossThreads)
+{
+    World world;
+    Pose2D start;
+    std::string err;
+    ASSERT_TRUE(makeWorld("corridor", 0.8, world, start, err)) << err;
+    std::vector<EpisodeConfig> configs(4, corridorEpisode(world, start));
+    for (std::size_t i = 0; i < configs.size(); ++i) {
+        configs[i].duration = 10.;
+        configs[i].seed = static_cast<std::uint32_t>(i);
+    }
+    std::vector<EpisodeResult> parallel = runEpisodes(configs, 4);
+    ASSERT_EQ(parallel.size(), configs.size());
+    for (std::size_t i = 0; i < configs.size(); ++i) {
+        EpisodeResult serial = runEpisode(configs[i]);
+        EXPECT_EQ(parallel[i].steps, serial.steps);
+        EXPECT_EQ(parallel[i].final_pose.x, serial.final_pose.x);
+        EXPECT_EQ(parallel[i].final_pose.y, serial.final_pose.y);
+    }
+}
@@ -0,0 +1,187 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "wall_tracking_executor/WallFollower.hpp"
+
+using namespace WallTracking;
+
+namespace {
+constexpr int kBeams = 1440;
+
+// config/wall_tracking_executor.param.yamlと同じ値
+ControlParams defaultParams()
+{
+    ControlParams p;
+    p.distance_from_wall = 0.8;
+    p.distance_to_stop = 0.8;
+    p.max_linear_vel = 0.22;
+    p.max_angular_vel = 0.7;
+    p.min_angular_vel = -0.7;
+    p.sampling_rate = 0.033;
+    p.kp = 12.;
+    p.start_deg_lateral = 69;
+    p.end_deg_lateral = 78;
+    p.stop_ray_th = 0.1;
+    p.wheel_separation = 0.28;
+    p.distance_to_skip = 0.6;
+    p.open_place_distance = 12.5;
+    const float div[] = {-9., 9., 9., 27., -27., -9., 27., 45., -45., -27.};
+    const float angvel[] = {0., 0.2, -0.2, 0.35, -0.35};
+    p.sector_num = 5;
+    std::copy(std::begin(div), std::end(div), p.detection_div_deg);
+    std::copy(std::begin(angvel), std::end(angvel), p.select_angvel);
+    std::string err;
+    EXPECT_TRUE(computeDerived(p, err)) << err;
+    return p;
+}
+
+ScanGeometry fullCircle()
+{
+    ScanGeometry g;
+    g.angle_increment = static_cast<float>(2. * M_PI / kBeams);
+    g.angle_min = static_cast<float>(-M_PI);
+    g.angle_max = g.angle_min + g.angle_increment * (kBeams - 1);
+    g.range_min = 0.1;
+    g.range_max = 30.;
+    return g;
+}
+
+// 角度(rad)ごとの距離からスキャンを作る
+std::vector<float> makeScan(const std::function<float(float)> &range_at)
+{
+    ScanGeometry g = fullCircle();
+    std::vector<float> ranges(kBeams);
+    for (int i = 0; i < kBeams; ++i) ranges[i] = range_at(g.angle_min + g.angle_increment * static_cast<float>(i));
+    return ranges;
+}
+
+// 左に壁、右側と前方は遠くまで開けた通路
+std::vector<float> corridor(float left_wall)
+{
+    return makeScan([left_wall](float a) {
+        float s = std::sin(a);
+        return s > 0.05f ? std::min(left_wall / s, 30.f) : std::numeric_limits<float>::infinity();
+    });
+}
+
+class WallFollowerTest : public testing::Test
+{
+protected:
+    ControlParams params_ = defaultParams();
+    WallFollower follower_;
+    ScanData scan_{kBeams};
+    FollowerInput input_;
+
+    void SetUp() override
+    {
+        follower_.setParams(params_);
+        input_.navigating = true;
+    }
+
+    const Decision &step(const std::vector<float> &ranges)
+    {
+        scan_.dataUpdate(RangeView(ranges), fullCircle());
+        return follower_.step(scan_, input_);
+    }
+};
+} // namespace
+
+TEST_F(WallFollowerTest, StopsWithoutNavigationGoal)
+{
+    input_.navigating = false;
+    const Decision &d = step(corridor(0.8));
+    EXPECT_EQ(d.action, FollowAction::STOP);
+    EXPECT_EQ(d.linear_x, 0.f);
+    EXPECT_EQ(d.angular_z, 0.f);
+}
+
+TEST_F(WallFollowerTest, TurnsAtFrontWall)
+{
+    const Decision &d = step(makeScan([](float a) {
+        float c = std::cos(a);
+        return c > 0.1f ? 0.5f / c : std::numeric_limits<float>::infinity();
+    }));
+    EXPECT_EQ(d.action, FollowAction::TURN);
+    EXPECT_EQ(d.linear_x, 0.f);
+    EXPECT_FLOAT_EQ(d.angular_z, static_cast<float>(DEG2RAD(-45)));
+    EXPECT_GE(d.front_wall_ratio, params_.stop_ray_th);
+}
+
+TEST_F(WallFollowerTest, TracksWallNearTargetDistance)
+{
+    const Decision &d = step(corridor(0.79));
+    EXPECT_EQ(d.action, FollowAction::WALL_TRACK);
+    EXPECT_FLOAT_EQ(d.linear_x, params_.max_linear_vel);
+    EXPECT_NEAR(d.lateral_mean, 0.79, 1e-3);
+    EXPECT_NEAR(d.angular_z, 12. * (0.79 - 0.8), 1e-2);
+}
+
+TEST_F(WallFollowerTest, ClampsTurnTowardsCloseWall)
+{
+    const Decision &d = step(corridor(0.6));
+    EXPECT_EQ(d.action, FollowAction::WALL_TRACK);
+    EXPECT_FLOAT_EQ(d.angular_z, params_.min_angular_vel);
+}
+
+TEST_F(WallFollowerTest, GainChangeResetsIntegral)
+{
+    params_.ki = 1.;
+    follower_.setParams(params_);
+    std::vector<float> ranges = corridor(0.7);
+    step(ranges);
+    float twice = step(ranges).pid_i;
+    EXPECT_NEAR(twice, 2. * -0.1 * params_.sampling_rate, 1e-4);
+    // ゲイン以外の変更では積分を持ち越す
+    params_.max_linear_vel = 0.2;
+    follower_.setParams(params_);
+    EXPECT_NEAR(step(ranges).pid_i, 3. * -0.1 * params_.sampling_rate, 1e-4);
+    params_.kp = 10.;
+    follower_.setParams(params_);
+    EXPECT_NEAR(step(ranges).pid_i, -0.1 * params_.sampling_rate, 1e-4);
+}
+
+TEST_F(WallFollowerTest, HeadsForOpenSectorOutdoors)
+{
+    input_.outdoor = true;
+    input_.gnss_nan = false;
+    const Decision &d = step(std::vector<float>(kBeams, std::numeric_limits<float>::infinity()));
+    EXPECT_TRUE(d.open_place);
+    EXPECT_EQ(d.action, FollowAction::OPEN_PLACE);
+    // 全て開けていれば先頭の正面の扇形を選び、開けた場所用の速度で進む
+    EXPECT_EQ(d.max_index, 0);
+    EXPECT_FLOAT_EQ(d.angular_z, params_.select_angvel[0]);
+    EXPECT_FLOAT_EQ(d.linear_x, params_.vel_open_place);
+}
+
+TEST_F(WallFollowerTest, SectorLimitKeepsSectorsNearestTheFront)
+{
+    input_.outdoor = true;
+    input_.gnss_nan = false;
+    // 右斜め前(-45〜-27度)だけが開けている
+    std::vector<float> ranges = makeScan([](float a) {
+        float deg = static_cast<float>(RAD2DEG(a));
+        return deg > -45.f && deg < -27.f ? std::numeric_limits<float>::infinity() : 1.5f;
+    });
+    const Decision &all = step(ranges);
+    EXPECT_EQ(all.action, FollowAction::OPEN_PLACE);
+    EXPECT_EQ(all.max_index, 4);
+    EXPECT_FLOAT_EQ(all.angular_z, params_.select_angvel[4]);
+
+    // 3つに絞ると中心が0, 18, -18度の扇形だけを評価し、±36度の扇形は選ばれない
+    input_.sector_limit = 3;
+    const Decision &limited = step(ranges);
+    EXPECT_NE(limited.action, FollowAction::OPEN_PLACE);
+    EXPECT_EQ(limited.max_index, params_.sector_num);
+    EXPECT_FLOAT_EQ(limited.evals[3], -1.f);
+    EXPECT_FLOAT_EQ(limited.evals[4], -1.f);
+}
@@ -0,0 +1,137 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+// Converts a binary decision trace to CSV, or to one raw little-endian file per
+// column plus schema.csv (name,type,rows) for columnar tools such as numpy/pandas.
+//
+// usage: decision_trace_decode trace [--csv file] [--columns dir]
+//        (CSV goes to stdout when neither option is given)
+
+#include "wall_tracking_executor/DecisionTrace.hpp"
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace WallTracking;
+
+namespace {
+const char *actionName(std::uint8_t action)
+{
+    switch (static_cast<FollowAction>(action)) {
+    case FollowAction::STOP: return "STOP";
+    case FollowAction::TURN: return "TURN";
+    case FollowAction::WALL_TRACK: return "WALL_TRACK";
+    case FollowAction::GAP_SKIP: return "GAP_SKIP";
+    case FollowAction::OPEN_PLACE: return "OPEN_PLACE";
+    }
+    return "UNKNOWN";
+}
+
+void writeCsv(std::FILE *out, const std::vector<TraceRecord> &records)
+{
+    std::fprintf(out, "seq,stamp_ns,action,linear_x,angular_z,open_place,gap_start,gap_end,front_left_wall,"
+        "open_place_ratio,open_place_mean,front_wall_ratio,lateral_mean,pid_p,pid_i,pid_d,sector_num,max_index");
+    for (int i = 0; i <= ControlParams::kMaxSectors; ++i) std::fprintf(out, ",evals_%d", i);
+    for (int i = 0; i <= ControlParams::kMaxSectors; ++i) std::fprintf(out, ",means_%d", i);
+    std::fprintf(out, "\n");
+    for (const auto &r : records) {
+        std::fprintf(out, "%lu,%ld,%s,%.3f,%.3f,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%d,%d",
+            static_cast<unsigned long>(r.seq), static_cast<long>(r.stamp_ns), actionName(r.action),
+            r.linear_x, r.angular_z, (r.flags & TraceRecord::OPEN_PLACE) != 0, (r.flags & TraceRecord::GAP_START) != 0,
+            (r.flags & TraceRecord::GAP_END) != 0, (r.flags & TraceRecord::FRONT_LEFT_WALL) != 0,
+            r.open_place_ratio, r.open_place_mean, r.front_wall_ratio, r.lateral_mean,
+            r.pid_p, r.pid_i, r.pid_d, r.sector_num, r.max_index);
+        for (float v : r.evals) std::fprintf(out, ",%.3f", v);
+        for (float v : r.means) std::fprintf(out, ",%.3f", v);
+        std::fprintf(out, "\n");
+    }
+}
+
+template<typename T>
+bool writeColumn(const std::string &dir, const std::string &name, const char *type,
+    const std::vector<TraceRecord> &records, std::function<T(const TraceRecord &)> get, std::FILE *schema)
+{
+    std::FILE *f = std::fopen((dir + "/" + name + ".bin").c_str(), "wb");
+    if (f == nullptr) return false;
+    std::vector<T> column;
+    column.reserve(records.size());
+    for (const auto &r : records) column.push_back(get(r));
+    std::fwrite(column.data(), sizeof(T), column.size(), f);
+    std::fclose(f);
+    std::fprintf(schema, "%s,%s,%zu\n", name.c_str(), type, records.size());
+    return true;
+}
+
+bool writeColumns(const std::string &dir, const std::vector<TraceRecord> &records)
+{
+    mkdir(dir.c_str(), 0755);
+    std::FILE *schema = std::fopen((dir + "/schema.csv").c_str(), "w");
+    if (schema == nullptr) return false;
+    std::fprintf(schema, "name,type,rows\n");
+    using R = const TraceRecord &;
+    bool ok = writeColumn<std::uint64_t>(dir, "seq", "u64", records, [](R r) { return r.seq; }, schema) &&
+        writeColumn<std::int64_t>(dir, "stamp_ns", "i64", records, [](R r) { return r.stamp_ns; }, schema) &&
+        writeColumn<std::uint8_t>(dir, "action", "u8", records, [](R r) { return r.action; }, schema) &&
+        writeColumn<std::uint8_t>(dir, "flags", "u8", records, [](R r) { return r.flags; }, schema) &&
+        writeColumn<std::int8_t>(dir, "sector_num", "i8", records, [](R r) { return r.sector_num; }, schema) &&
+        writeColumn<std::int8_t>(dir, "max_index", "i8", records, [](R r) { return r.max_index; }, schema) &&
+        writeColumn<float>(dir, "linear_x", "f32", records, [](R r) { return r.linear_x; }, schema) &&
+        writeColumn<float>(dir, "angular_z", "f32", records, [](R r) { return r.angular_z; }, schema) &&
+        writeColumn<float>(dir, "open_place_ratio", "f32", records, [](R r) { return r.open_place_ratio; }, schema) &&
+        writeColumn<float>(dir, "open_place_mean", "f32", records, [](R r) { return r.open_place_mean; }, schema) &&
+        writeColumn<float>(dir, "front_wall_ratio", "f32", records, [](R r) { return r.front_wall_ratio; }, schema) &&
+        writeColumn<float>(dir, "lateral_mean", "f32", records, [](R r) { return r.lateral_mean; }, schema) &&
+        writeColumn<float>(dir, "pid_p", "f32", records, [](R r) { return r.pid_p; }, schema) &&
+        writeColumn<float>(dir, "pid_i", "f32", records, [](R r) { return r.pid_i; }, schema) &&
+        writeColumn<float>(dir, "pid_d", "f32", records, [](R r) { return r.pid_d; }, schema);
+    for (int i = 0; ok && i <= ControlParams::kMaxSectors; ++i) {
+        ok = writeColumn<float>(dir, "evals_" + std::to_string(i), "f32", records, [i](R r) { return r.evals[i]; }, schema) &&
+            writeColumn<float>(dir, "means_" + std::to_string(i), "f32", records, [i](R r) { return r.means[i]; }, schema);
+    }
+    std::fclose(schema);
+    return ok;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::string path, csv, columns;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--csv" && has_value) csv = argv[++i];
+        else if (a == "--columns" && has_value) columns = argv[++i];
+        else if (path.empty() && a[0] != '-') path = a;
+        else std::cerr << "ignoring unknown argument: " << a << std::endl;
+    }
+    if (path.empty()) {
+        std::cerr << "usage: decision_trace_decode trace [--csv file] [--columns dir]" << std::endl;
+        return 1;
+    }
+    std::vector<TraceRecord> records;
+    std::string err;
+    if (!readDecisionTrace(path, records, err)) {
+        std::cerr << err << std::endl;
+        return 1;
+    }
+    if (!columns.empty() && !writeColumns(columns, records)) {
+        std::cerr << "failed to write columns to " << columns << std::endl;
+        return 1;
+    }
+    if (!csv.empty() || columns.empty()) {
+        std::FILE *out = csv.empty() ? stdout : std::fopen(csv.c_str(), "w");
+        if (out == nullptr) {
+            std::cerr << "failed to open " << csv << std::endl;
+            return 1;
+        }
+        writeCsv(out, records);
+        if (out != stdout) std::fclose(out);
+    }
+    std::fprintf(stderr, "%zu records\n", records.size());
+    return 0;
+}
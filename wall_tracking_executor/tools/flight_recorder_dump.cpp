@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: 2023 Makoto Yoshigoe myoshigo0127@gmail.com
+// SPDX-License-Identifier: Apache-2.0
+
+// Dumps a flight recorder file as CSV, oldest record first.
+//
+// usage: flight_recorder_dump file [--last-seconds sec] [--last n] [--ranges]
+
+#include "wall_tracking_executor/FlightRecorder.hpp"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace WallTracking;
+
+int main(int argc, char *argv[])
+{
+    std::string path;
+    double last_seconds = 0.;
+    std::size_t last = 0;
+    bool with_ranges = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--last-seconds" && has_value) last_seconds = std::stod(argv[++i]);
+        else if (a == "--last" && has_value) last = std::stoul(argv[++i]);
+        else if (a == "--ranges") with_ranges = true;
+        else if (path.empty() && a[0] != '-') path = a;
+        else std::cerr << "ignoring unknown argument: " << a << std::endl;
+    }
+    if (path.empty()) {
+        std::cerr << "usage: flight_recorder_dump file [--last-seconds sec] [--last n] [--ranges]" << std::endl;
+        return 1;
+    }
+    std::vector<FlightRecord> records;
+    std::vector<float> ranges;
+    std::size_t max_ranges = 0;
+    std::string err;
+    if (!readFlightRecords(path, records, with_ranges ? &ranges : nullptr, max_ranges, err)) {
+        std::cerr << err << std::endl;
+        return 1;
+    }
+    // 最後の記録の時刻から遡って残す範囲を決める
+    std::size_t begin = 0;
+    if (last > 0 && last < records.size()) begin = records.size() - last;
+    if (last_seconds > 0. && !records.empty()) {
+        std::int64_t from = records.back().stamp_ns - static_cast<std::int64_t>(last_seconds * 1e9);
+        while (begin < records.size() && records[begin].stamp_ns < from) ++begin;
+    }
+
+    std::printf("seq,stamp_ns,action,flags,scan_age,scan_duration,cmd_linear_x,cmd_angular_z,lateral_mean,"
+        "front_wall_ratio,open_place_ratio,open_place_mean,pid_p,pid_i,pid_d,sector_num,max_index,evals,range_count%s\n",
+        with_ranges ? ",ranges" : "");
+    for (std::size_t k = begin; k < records.size(); ++k) {
+        const FlightRecord &r = records[k];
+        std::printf("%lu,%ld,%u,%u,%.4f,%.6f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%u,%d,",
+            static_cast<unsigned long>(r.seq), static_cast<long>(r.stamp_ns), r.action, r.flags,
+            r.scan_age, r.scan_duration, r.cmd_linear_x, r.cmd_angular_z, r.lateral_mean,
+            r.front_wall_ratio, r.open_place_ratio, r.open_place_mean, r.pid_p, r.pid_i, r.pid_d,
+            r.sector_num, r.max_index);
+        // 扇形ごとの評価値と生のレンジはセミコロン区切りで1列にまとめる
+        for (int i = 0; i < r.sector_num && i <= ControlParams::kMaxSectors; ++i) std::printf(i ? ";%.3f" : "%.3f", r.evals[i]);
+        std::printf(",%u", r.range_count);
+        if (with_ranges) {
+            std::printf(",");
+            const float *p = ranges.data() + k * max_ranges;
+            for (std::size_t i = 0; i < r.range_count && i < max_ranges; ++i) std::printf(i ? ";%.3f" : "%.3f", p[i]);
+        }
+        std::printf("\n");
+    }
+    std::fprintf(stderr, "%zu of %zu records\n", records.size() - begin, records.size());
+    return 0;
+}